@@ -0,0 +1,98 @@
+#include <iostream>
+#include <chrono>
+#include <cmath>
+#include <random>
+
+#include <matrix.hpp>
+#include <batchedmatrix.hpp>
+
+namespace bla = ASC_bla;
+
+int main()
+{
+  size_t batch = 10003, n = 8;   // not a multiple of the SIMD width
+  std::mt19937 gen(42);
+  std::uniform_real_distribution<double> dist(-1, 1);
+
+  bla::BatchedMatrix<double> A(batch, n, n), B(batch, n, n), C(batch, n, n);
+  for (size_t b = 0; b < batch; b++)
+    for (size_t x = 0; x < n; x++)
+      for (size_t y = 0; y < n; y++)
+        {
+          A(b,x,y) = dist(gen);   // pivoting needed, no dominant diagonal
+          B(b,x,y) = dist(gen);
+        }
+
+  bla::BatchedGemm (A, B, C);
+  bla::BatchedMatrix<double> Ainv = A;
+  bla::BatchedInverse (Ainv);
+  bla::BatchedMatrix<double> LU = A, X = B;
+  bla::BatchedLUSolve (LU, X);
+
+  double err_gemm = 0, err_inv = 0, err_solve = 0;
+  for (size_t b = 0; b < batch; b++)
+    {
+      // constructed from the views, assigning a view to a Matrix would rebind it
+      bla::Matrix<double> a(A[b]), bm(B[b]);
+      bla::Matrix<double> c = a * bm;
+      bla::Matrix<double> ainv = a.Inverse();
+      bla::Matrix<double> x = ainv * bm;
+      for (size_t i = 0; i < n; i++)
+        for (size_t j = 0; j < n; j++)
+          {
+            err_gemm = std::max(err_gemm, std::fabs(C(b,i,j) - c(i,j)));
+            err_inv = std::max(err_inv, std::fabs(Ainv(b,i,j) - ainv(i,j)) / (1+std::fabs(ainv(i,j))));
+            err_solve = std::max(err_solve, std::fabs(X(b,i,j) - x(i,j)) / (1+std::fabs(x(i,j))));
+          }
+    }
+  std::cout << "SIMD width " << A.SW << ", errors: gemm " << err_gemm
+            << ", inverse " << err_inv << ", solve " << err_solve << std::endl;
+  bool ok = err_gemm < 1e-12 && err_inv < 1e-6 && err_solve < 1e-6;
+
+  // member 1234 singular, the padding lanes of the last block must not count
+  bla::BatchedMatrix<double> S = A;
+  for (size_t y = 0; y < n; y++)
+    S(1234,3,y) = 0;
+  try
+    {
+      bla::BatchedInverse (S);
+      ok = false;
+    }
+  catch (std::runtime_error & e)
+    {
+      std::cout << "singular: " << e.what() << std::endl;
+      ok = ok && std::string(e.what()).find("1234") != std::string::npos;
+    }
+  if (!ok)
+    {
+      std::cout << "batched test failed" << std::endl;
+      return 1;
+    }
+
+  // against a loop over Matrix objects
+  auto time = [] (auto func)
+  {
+    auto start = std::chrono::high_resolution_clock::now();
+    func();
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double>(end-start).count();
+  };
+
+  std::vector<bla::Matrix<double>> As, Bs;
+  for (size_t b = 0; b < batch; b++)
+    {
+      As.emplace_back(A[b]);
+      Bs.emplace_back(B[b]);
+    }
+  double sum = 0;
+  double t_loop_gemm = time ([&] { for (size_t b = 0; b < batch; b++) { bla::Matrix<double> c = As[b]*Bs[b]; sum += c(0,0); } });
+  double t_loop_inv = time ([&] { for (size_t b = 0; b < batch; b++) sum += As[b].Inverse()(0,0); });
+  double t_gemm = time ([&] { bla::BatchedGemm (A, B, C); });
+  double t_inv = time ([&] { Ainv = A; bla::BatchedInverse (Ainv); });
+  double t_solve = time ([&] { LU = A; X = B; bla::BatchedLUSolve (LU, X); });
+
+  std::cout << batch << " matrices " << n << "x" << n << ", ns per member (" << sum << ")" << std::endl
+            << "gemm:    Matrix loop " << t_loop_gemm/batch*1e9 << ", batched " << t_gemm/batch*1e9 << std::endl
+            << "inverse: Matrix loop " << t_loop_inv/batch*1e9 << ", batched " << t_inv/batch*1e9 << std::endl
+            << "solve:   batched " << t_solve/batch*1e9 << std::endl;
+}
@@ -1,4 +1,8 @@
 #include <iostream>
+#include <chrono>
+#include <thread>
+#include <tuple>
+#include <atomic>
 
 #include <matrix.hpp>
 
@@ -22,6 +26,164 @@ int main()
     }
   }
 
+  // check the kernels on sizes with leftover rows and columns
+  for (auto [n, m, k] : { std::tuple<size_t,size_t,size_t>(37, 29, 23), { 301, 517, 700 } })
+    {
+      bla::Matrix<double> a(k, n), b(m, k), c(m, n), c2(m, n);
+      for (size_t x = 0; x < k; x++)
+        for (size_t y = 0; y < n; y++)
+          a(x,y) = double(x) - 0.5*y;
+      for (size_t x = 0; x < m; x++)
+        for (size_t y = 0; y < k; y++)
+          b(x,y) = 1.0 / (1+x+y);
+      c = 1.0;
+      c2 = 1.0;
+
+      bla::addMatMat2(a, b, c);
+      bla::addMatMat(a, b, c2);
+
+      double err = 0, err2 = 0;
+      for (size_t x = 0; x < m; x++)
+        for (size_t y = 0; y < n; y++)
+          {
+            double s = 1;
+            for (size_t l = 0; l < k; l++)
+              s += a(l,y) * b(x,l);
+            err = std::max(err, std::fabs(s-c(x,y)));
+            err2 = std::max(err2, std::fabs(s-c2(x,y)));
+          }
+      std::cout << "n = " << n << ", m = " << m << ", k = " << k
+                << ": addMatMat2 error = " << err << ", addMatMat error = " << err2 << std::endl;
+    }
+
+  // product expressions are evaluated by gemm
+  {
+    size_t n = 53, m = 41, k = 67;
+    bla::Matrix<double> a(k, n), b(m, k), d(m, n), e(m, n), c(m, n), ref(m, n);
+    for (size_t x = 0; x < k; x++)
+      for (size_t y = 0; y < n; y++)
+        a(x,y) = std::sin(double(x+2*y));
+    for (size_t x = 0; x < m; x++)
+      for (size_t y = 0; y < k; y++)
+        b(x,y) = std::cos(double(3*x+y));
+    for (size_t x = 0; x < m; x++)
+      for (size_t y = 0; y < n; y++)
+        {
+          d(x,y) = 1.0 + x;
+          e(x,y) = 0.5 * y;
+        }
+
+    auto product = [&] (size_t x, size_t y)
+    {
+      double s = 0;
+      for (size_t l = 0; l < k; l++)
+        s += a(l,y) * b(x,l);
+      return s;
+    };
+    auto error = [&] (auto f)
+    {
+      double err = 0;
+      for (size_t x = 0; x < m; x++)
+        for (size_t y = 0; y < n; y++)
+          err = std::max(err, std::fabs(c(x,y) - f(x,y)));
+      return err;
+    };
+
+    c = a*b;
+    std::cout << "C = A*B, error = " << error(product) << std::endl;
+    c = a*b + 2*d;
+    std::cout << "C = A*B+2*D, error = "
+              << error([&] (size_t x, size_t y) { return product(x,y) + 2*d(x,y); }) << std::endl;
+    c = d + 3*(a*b) + e;
+    std::cout << "C = D+3*A*B+E, error = "
+              << error([&] (size_t x, size_t y) { return d(x,y) + 3*product(x,y) + e(x,y); }) << std::endl;
+    c = d;
+    c = c + a*b;
+    std::cout << "C = C+A*B, error = "
+              << error([&] (size_t x, size_t y) { return d(x,y) + product(x,y); }) << std::endl;
+
+    // aliasing: the result is also an operand of the product
+    bla::Matrix<double> sq(m, m);
+    for (size_t x = 0; x < m; x++)
+      for (size_t y = 0; y < m; y++)
+        sq(x,y) = (x == y) ? 2.0 : 0.0;
+    c = d;
+    c = c*sq;
+    std::cout << "C = C*S, error = "
+              << error([&] (size_t x, size_t y) { return 2*d(x,y); }) << std::endl;
+
+    // row major matrices and transposed views go to gemm without copies
+    auto errorOf = [&] (const auto & M, auto f)
+    {
+      double err = 0;
+      for (size_t x = 0; x < m; x++)
+        for (size_t y = 0; y < n; y++)
+          err = std::max(err, std::fabs(M(x,y) - f(x,y)));
+      return err;
+    };
+    bla::Matrix<double,bla::RowMajor> ar(k, n), cr(m, n);
+    ar = a;
+    bla::Matrix<double> at(n, k), ct(n, m);
+    at = bla::Trans(a);
+    c = ar*b;
+    std::cout << "C = A*B, A row major, error = " << error(product) << std::endl;
+    c = bla::Trans(at)*b;
+    std::cout << "C = Trans(At)*B, error = " << error(product) << std::endl;
+    cr = a*b + 2*d;
+    std::cout << "C = A*B+2*D, C row major, error = "
+              << errorOf(cr, [&] (size_t x, size_t y) { return product(x,y) + 2*d(x,y); })
+              << ", rows contiguous = " << (&cr(1,0) == &cr(0,0)+1) << std::endl;
+    bla::Trans(ct) = a*b;
+    std::cout << "Trans(Ct) = A*B, error = " << errorOf(bla::Trans(ct), product) << std::endl;
+  }
+
+  // single core timing of the unpacked kernel
+  for (size_t n : { 96, 192, 384 })
+    {
+      bla::Matrix<double> a(n, n), b(n, n), c(n, n);
+      a = 1.0; b = 1.0; c = 0.0;
+      size_t runs = 1 + size_t(2e9 / (2.0*n*n*n));
+      auto start = std::chrono::high_resolution_clock::now();
+      for (size_t r = 0; r < runs; r++)
+        bla::addMatMat2(a, b, c);
+      auto end = std::chrono::high_resolution_clock::now();
+      double time = std::chrono::duration<double>(end-start).count();
+      std::cout << "addMatMat2, n = " << n << ", GFlops = " << 2.0*n*n*n*runs/time*1e-9 << std::endl;
+    }
+
+  // packed and parallel, the pool stays alive for all runs
+  {
+  ASC_HPC::TaskManager tm;
+  std::cout << "threads: " << tm.numThreads() << std::endl;
+
+  // nested parallel loops
+  std::atomic<int> cnt{0};
+  ASC_HPC::RunParallel (8, [&] (int i, int size)
+  {
+    ASC_HPC::RunParallel (8, [&] (int j, int size2) { cnt++; });
+  });
+  std::cout << "nested RunParallel: " << cnt << " of 64 tasks" << std::endl;
+
+  for (size_t n : { 256, 512, 1024, 2048 })
+    {
+      bla::Matrix<double> a(n, n), b(n, n), c(n, n);
+      a = 1.0; b = 1.0; c = 0.0;
+      size_t runs = 1 + size_t(1e10 / (2.0*n*n*n));
+      auto start = std::chrono::high_resolution_clock::now();
+      for (size_t r = 0; r < runs; r++)
+        bla::addMatMat(a, b, c);
+      auto end = std::chrono::high_resolution_clock::now();
+      double time = std::chrono::duration<double>(end-start).count();
+      std::cout << "addMatMat, n = " << n << ", GFlops = " << 2.0*n*n*n*runs/time*1e-9 << std::endl;
+    }
+
+  // idle workers go to sleep
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  auto stat = ASC_HPC::GetWorkerStatistics();
+  std::cout << "workers: " << stat.sleeps << " sleeps, " << stat.wakeups << " wakeups, "
+            << stat.spin_time << " s spinning" << std::endl;
+  }
+
   ASC_bla::addMatMat(A, B, C);
 
   /*std::cout << "A:\n" << A;
@@ -0,0 +1,106 @@
+#include <iostream>
+#include <chrono>
+#include <cmath>
+#include <random>
+
+#include <vector.hpp>
+#include <matrix.hpp>
+#include <smallmatrix.hpp>
+
+namespace bla = ASC_bla;
+
+// max |A*inv(A) - I| and the product rule det(A*A) = det(A)^2 over random matrices
+template <size_t N>
+bool checkInverse (std::mt19937 & gen)
+{
+  std::uniform_real_distribution<double> dist(-1, 1);
+  double err = 0, derr = 0;
+  for (int k = 0; k < 1000; k++)
+    {
+      bla::Mat<N,N> a;
+      for (size_t x = 0; x < N; x++)
+        for (size_t y = 0; y < N; y++)
+          a(x,y) = dist(gen) + (x == y ? N : 0);
+      bla::Mat<N,N> prod = a * bla::Inverse(a);
+      for (size_t x = 0; x < N; x++)
+        for (size_t y = 0; y < N; y++)
+          err = std::max(err, std::fabs(prod(x,y) - (x == y)));
+
+      double d = bla::Det(a);
+      derr = std::max(derr, std::fabs(bla::Det(bla::Mat<N,N>(a*a)) - d*d) / (d*d));
+    }
+  std::cout << N << "x" << N << ": |A*inv(A)-I| = " << err
+            << ", relative error of det(A*A) = " << derr << std::endl;
+  return err < 1e-12 && derr < 1e-12;
+}
+
+int main()
+{
+  bla::Vec<3> a(1, 2, 3), b(1.0);
+  bla::Vec<3> c = a + 2*b;
+  std::cout << "a+2*b = " << c << ", <a,b> = " << dot(a,b) << std::endl;
+
+  // small vectors mix with Vector
+  bla::Vector<double> v = a + c;
+  std::cout << "a+c as Vector = " << v << std::endl;
+
+  bla::Mat<3,2> m;
+  for (size_t x = 0; x < 2; x++)
+    for (size_t y = 0; y < 3; y++)
+      m(x,y) = 10*y + x;
+  std::cout << "m = " << std::endl << m
+            << "m*Trans(m) = " << std::endl << m*bla::Trans(m)
+            << "m * (1,1) = " << m * bla::Vec<2>(1.0) << std::endl;
+
+  std::mt19937 gen(42);
+  bool ok = checkInverse<1>(gen) && checkInverse<2>(gen) && checkInverse<3>(gen)
+    && checkInverse<4>(gen) && checkInverse<6>(gen);
+
+  try
+    {
+      bla::Inverse(bla::Mat<3,3>(1.0));
+      ok = false;
+    }
+  catch (std::runtime_error &) { }
+  if (!ok)
+    {
+      std::cout << "small matrix test failed" << std::endl;
+      return 1;
+    }
+
+  // element matrices B^T D B of a 3x3 problem, stack against heap
+  size_t num = 1000000;
+  bla::Mat<3,3> D = bla::Mat<3,3>::Identity();
+  D(1,0) = D(0,1) = 0.5;
+  double sum = 0;
+  auto start = std::chrono::high_resolution_clock::now();
+  for (size_t i = 0; i < num; i++)
+    {
+      bla::Mat<3,3> B = bla::Mat<3,3>::Identity();
+      B(0,1) = 1e-6*i;
+      bla::Mat<3,3> elmat = bla::Trans(B) * (D * B);
+      sum += bla::Det(elmat) + bla::Inverse(elmat)(2,2);
+    }
+  auto end = std::chrono::high_resolution_clock::now();
+  std::cout << "Mat<3,3>:    " << std::chrono::duration<double>(end-start).count()/num*1e9
+            << " ns per element matrix and inverse (" << sum << ")" << std::endl;
+
+  size_t numdyn = num / 10;
+  bla::Matrix<double> Dd(3,3);
+  Dd = D;
+  sum = 0;
+  start = std::chrono::high_resolution_clock::now();
+  for (size_t i = 0; i < numdyn; i++)
+    {
+      bla::Matrix<double> B(3,3), Bt(3,3);
+      B = bla::Mat<3,3>::Identity();
+      B(0,1) = 1e-6*i;
+      Bt = bla::Trans(bla::Mat<3,3>(B));
+      bla::Matrix<double> DB = Dd * B;
+      bla::Matrix<double> elmat = Bt * DB;
+      sum += elmat.Inverse()(2,2);
+    }
+  end = std::chrono::high_resolution_clock::now();
+  std::cout << "Matrix<double>: " << std::chrono::duration<double>(end-start).count()/numdyn*1e9
+            << " ns per element matrix and inverse (" << sum << ")" << std::endl;
+}
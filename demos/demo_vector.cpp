@@ -1,12 +1,18 @@
 #include <iostream>
+#include <chrono>
+#include <cmath>
 
 #include <vector.hpp>
 #include <matrix.hpp>
 
 namespace bla = ASC_bla;
 
+// freed after the thread cache of the main thread is gone
+static bla::Vector<double> static_vector(100);
+
 int main()
 {
+  static_vector = 1.0;
   size_t n = 10;
   bla::Vector<double> x(n), y(n);
 
@@ -32,4 +38,64 @@ int main()
   x.slice(1,5) = 10;
   
   std::cout << "x = " << x << std::endl;  
+
+  // temporaries from the memory pool, compared to new/delete
+  auto timeTemporaries = [] (auto vec, const char * name)
+  {
+    typedef decltype(vec) TVec;
+    volatile size_t vn = 1000;   // not known at compile time
+    size_t n = vn, runs = 200000;
+    TVec a(n), b(n);
+    a = 1.0; b = 2.0;
+    double sum = 0;
+    auto start = std::chrono::high_resolution_clock::now();
+    for (size_t i = 0; i < runs; i++)
+      {
+        TVec c = a+b;
+        sum += c(i % n);
+        a(i % n) = 1.0;
+      }
+    auto end = std::chrono::high_resolution_clock::now();
+    if (sum != 3.0*runs) std::cout << "wrong sum" << std::endl;
+    std::cout << name << ": " << std::chrono::duration<double>(end-start).count()/runs*1e9
+              << " ns per temporary, aligned = " << (size_t(a.data()) % 64 == 0) << std::endl;
+  };
+  timeTemporaries (bla::Vector<double>(0), "pool allocator");
+  timeTemporaries (bla::Vector<double,std::allocator<double>>(0), "std::allocator");
+
+  // SIMD and parallel evaluation of expressions, against the entry by entry result
+  {
+    size_t n = 1000003;
+    bla::Vector<double> a(n), b(n), c(n);
+    for (size_t i = 0; i < n; i++)
+      {
+        a(i) = std::sin(double(i));
+        b(i) = 1.0 / (1+i);
+      }
+    c = a + 3*b + (-2)*a;
+    double err = 0;
+    for (size_t i = 0; i < n; i++)
+      err = std::max(err, std::fabs(c(i) - (a(i) + 3*b(i) - 2*a(i))));
+    // strided views take the entry by entry path
+    c.slice(0,2) = a.slice(1,2) + b.slice(0,2);
+    for (size_t i = 0; i < n/2; i++)
+      err = std::max(err, std::fabs(c(2*i) - (a(2*i+1) + b(2*i))));
+    std::cout << "expression error = " << err << std::endl;
+    if (err > 1e-15)
+      return 1;
+  }
+
+  for (size_t n : { size_t(1e3), size_t(1e5), size_t(1e7) })
+    {
+      bla::Vector<double> x(n), y(n), z(n);
+      x = 1.0; y = 2.0;
+      size_t runs = 1 + size_t(1e9) / n;
+      auto start = std::chrono::high_resolution_clock::now();
+      for (size_t r = 0; r < runs; r++)
+        z = x + 3*y;
+      auto end = std::chrono::high_resolution_clock::now();
+      double time = std::chrono::duration<double>(end-start).count();
+      std::cout << "z = x+3*y, n = " << n << ": "
+                << 3*n*sizeof(double)*runs/time*1e-9 << " GB/s" << std::endl;
+    }
 }
@@ -0,0 +1,122 @@
+#include <iostream>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <new>
+
+#include <vector.hpp>
+#include <matrix.hpp>
+#include <smallmatrix.hpp>
+
+namespace bla = ASC_bla;
+
+/*
+  Building and evaluating expressions must not allocate: operands are
+  held as views, or by reference if they own their entries. Every
+  operator new of the program is counted; the blocks cached by the
+  MemoryPool are given back before each count, so a copy of a vector
+  or matrix cannot be served from the cache.
+*/
+
+static size_t allocations = 0;
+
+void * operator new (size_t bytes)
+{
+  allocations++;
+  if (void * p = std::malloc(bytes ? bytes : 1)) return p;
+  throw std::bad_alloc();
+}
+void * operator new (size_t bytes, std::align_val_t align)
+{
+  allocations++;
+  size_t a = size_t(align);
+  if (void * p = std::aligned_alloc(a, (bytes+a-1)/a*a)) return p;
+  throw std::bad_alloc();
+}
+void operator delete (void * p) noexcept { std::free(p); }
+void operator delete (void * p, size_t) noexcept { std::free(p); }
+void operator delete (void * p, std::align_val_t) noexcept { std::free(p); }
+void operator delete (void * p, size_t, std::align_val_t) noexcept { std::free(p); }
+
+
+// allocations done by f
+template <typename F>
+size_t countAllocations (F f)
+{
+  bla::MemoryPool<ASC_ALIGNMENT>::release();
+  size_t before = allocations;
+  f();
+  return allocations - before;
+}
+
+int main()
+{
+  bool ok = true;
+  auto check = [&ok] (const char * name, size_t count)
+  {
+    std::cout << name << ": " << count << " allocations" << std::endl;
+    ok = ok && count == 0;
+  };
+
+  size_t n = 1000;
+  bla::Vector<double> x(n), y(n), z(n);
+  x = 1.0; y = 2.0;
+  check ("z = x+3*y", countAllocations ([&] { z = x + 3*y; }));
+  check ("auto e = x+3*y+x", countAllocations ([&] { auto e = x + 3*y + x; z = e; }));
+
+  bla::Vec<3> a(1, 2, 3), b(4, 5, 6), c;
+  check ("Vec<3> c = a+2*b", countAllocations ([&] { c = a + 2*b; }));
+
+  bla::Matrix<double> A(50, 50), B(50, 50), C(50, 50);
+  A = 1.0; B = 2.0;
+  check ("C = A+2*B", countAllocations ([&] { C = A + 2*B; }));
+
+  // operands owning their entries are held by reference, views by value
+  auto ev = a + b;
+  auto ex = x + y;
+  std::cout << "sizeof(Vec<3> + Vec<3>) = " << sizeof(ev)
+            << ", sizeof(Vector + Vector) = " << sizeof(ex) << std::endl;
+  ok = ok && sizeof(ev) == 2*sizeof(void*) && sizeof(ex) == 2*sizeof(bla::VectorView<double>);
+
+  if (!ok)
+    {
+      std::cout << "expression test failed" << std::endl;
+      return 1;
+    }
+
+  // building an expression is independent of the vector size
+  for (size_t len : { size_t(1e3), size_t(1e7) })
+    {
+      bla::Vector<double> u(len), v(len);
+      size_t runs = 1000000;
+      double sum = 0;
+      auto start = std::chrono::high_resolution_clock::now();
+      for (size_t r = 0; r < runs; r++)
+        {
+          auto e = u + 3*v + u;
+          sum += e.size();
+        }
+      auto end = std::chrono::high_resolution_clock::now();
+      std::cout << "build x+3*y+x, n = " << len << ": "
+                << std::chrono::duration<double>(end-start).count()/runs*1e9 << " ns ("
+                << sum/runs << ")" << std::endl;
+    }
+
+  // small vectors: the entries are read once, when the expression is evaluated
+  {
+    bla::Vec<64> p(1.0), q(2.0), r(3.0), s;
+    size_t runs = 2000000;
+    double sum = 0;
+    auto start = std::chrono::high_resolution_clock::now();
+    for (size_t i = 0; i < runs; i++)
+      {
+        p(i % 64) = double(i);
+        s = p + 2*q + 3*r;
+        sum += s(i % 64);
+      }
+    auto end = std::chrono::high_resolution_clock::now();
+    std::cout << "Vec<64> s = p+2*q+3*r: "
+              << std::chrono::duration<double>(end-start).count()/runs*1e9 << " ns ("
+              << sum << ")" << std::endl;
+  }
+}
@@ -1,4 +1,8 @@
 #include <iostream>
+#include <chrono>
+#include <cmath>
+#include <complex>
+#include <cstdint>
 
 #include <vector.hpp>
 #include <matrix.hpp>
@@ -9,6 +13,184 @@ using namespace ASC_bla;
 using namespace std;
 
 
+/*
+  The BLAS dispatch: every routine is run once with the library kernels
+  (threshold SIZE_MAX) and once with BLAS (threshold 0), on contiguous,
+  window, strided and transposed views, and the results are compared.
+*/
+
+template <typename T>
+T entry (double re, double im)
+{
+  if constexpr (std::is_arithmetic_v<T>)
+    return T(re);
+  else
+    return T(re, im);
+}
+
+template <typename T, ORDERING ORD>
+void fill (MatrixView<T,ORD> a, int seed, double diag = 0)
+{
+  for (size_t j = 0; j < a.width(); j++)
+    for (size_t i = 0; i < a.height(); i++)
+      a(j,i) = entry<T>(std::sin(1.0+seed+i+2.7*j) + (i == j ? diag : 0), std::cos(seed+3.1*i+j));
+}
+
+template <typename T, typename TD>
+void fill (VectorView<T,TD> x, int seed)
+{
+  for (size_t i = 0; i < x.size(); i++)
+    x(i) = entry<T>(std::cos(seed+0.7*i), std::sin(2.0*seed+i));
+}
+
+/*
+  calls f with an h x w view into mem: kind 0 column major, 1 a window of
+  a larger matrix, 2 every other row (no contiguous direction), 3 to 5
+  the same kinds transposed (row major)
+*/
+template <typename T, typename F>
+void withView (T * mem, int kind, size_t h, size_t w, F f)
+{
+  size_t H = kind < 3 ? h : w, W = kind < 3 ? w : h;
+  MatrixView<T> v (W, H, mem);
+  if (kind % 3 == 1) v = MatrixView<T> (W+4, H+5, W, H, 3, 2, mem);
+  if (kind % 3 == 2) v = MatrixView<T> (W, 2*H, 1, 2, mem);
+  if (kind < 3)
+    f(v);
+  else
+    f(Trans(v));
+}
+
+template <typename T, ORDERING ORD>
+void store (MatrixView<T,ORD> a, std::vector<T> & res)
+{
+  res.clear();
+  for (size_t j = 0; j < a.width(); j++)
+    for (size_t i = 0; i < a.height(); i++)
+      res.push_back(a(j,i));
+}
+
+template <typename T>
+double relDiff (const std::vector<T> & a, const std::vector<T> & b)
+{
+  double diff = 0, norm = 1e-300;
+  for (size_t i = 0; i < a.size(); i++)
+    {
+      diff = std::max<double>(diff, std::abs(a[i]-b[i]));
+      norm = std::max<double>(norm, std::abs(a[i]));
+    }
+  return (a.size() == b.size()) ? diff / norm : 1e300;
+}
+
+// largest relative difference of library and BLAS results of op(mem1, mem2, mem3, res)
+template <typename T, typename OP>
+double compareBlas (OP op)
+{
+  std::vector<T> res[2];
+  size_t threshold = BlasThreshold();
+  for (int b = 0; b < 2; b++)
+    {
+      SetBlasThreshold (b ? 0 : SIZE_MAX);
+      std::vector<T> mem1(4096), mem2(4096), mem3(4096);
+      op (mem1.data(), mem2.data(), mem3.data(), res[b]);
+    }
+  SetBlasThreshold (threshold);
+  return relDiff (res[0], res[1]);
+}
+
+template <typename T>
+bool testBlas (const char * name)
+{
+  double tol = (sizeof(T) == sizeof(float) || std::is_same_v<T,std::complex<float>>) ? 1e-4 : 1e-12;
+  double err = 0;
+  size_t h = 37, w = 29, k = 23;
+
+  for (int strided = 0; strided < 2; strided++)
+    {
+      size_t dist = strided ? 2 : 1;
+      auto vec = [&] (T * mem, size_t n) { return VectorView<T,size_t> (n, dist, mem); };
+      err = std::max (err, compareBlas<T> ([&] (T * m1, T * m2, T *, std::vector<T> & res)
+      {
+        auto x = vec(m1, h), y = vec(m2, h);
+        fill (x, 1); fill (y, 2);
+        blas::scal (entry<T>(0.5, 0.25), x);
+        blas::axpy (entry<T>(2, -1), x, y);
+        res.assign ({ y(0), y(h-1), blas::dot(x, y), T(blas::nrm2(y)) });
+      }));
+
+      for (int ka = 0; ka < 6; ka++)
+        {
+          // y = alpha A x + beta y, A += alpha x y^T, x = A^{-1} x
+          err = std::max (err, compareBlas<T> ([&] (T * m1, T * m2, T * m3, std::vector<T> & res)
+          {
+            withView (m1, ka, h, w, [&] (auto a)
+            {
+              auto x = vec(m2, w), y = vec(m3, h);
+              fill (a, 3); fill (x, 4); fill (y, 5);
+              blas::gemv (entry<T>(0.5, 1), a, x, entry<T>(2, 0), y);
+              blas::ger (entry<T>(-1, 0.5), y, x, a);
+              store (a, res);
+              for (size_t i = 0; i < h; i++) res.push_back(y(i));
+            });
+          }));
+          for (auto uplo : { blas::Lower, blas::Upper })
+            err = std::max (err, compareBlas<T> ([&] (T * m1, T * m2, T *, std::vector<T> & res)
+            {
+              withView (m1, ka, k, k, [&] (auto a)
+              {
+                auto x = vec(m2, k);
+                fill (a, 6, 4.0); fill (x, 7);
+                blas::trsv (uplo, a, x);
+                blas::trsv (uplo, a, x, blas::Unit);
+                res.clear();
+                for (size_t i = 0; i < k; i++) res.push_back(x(i));
+              });
+            }));
+        }
+    }
+
+  for (int ka = 0; ka < 6; ka++)
+    for (int kb = 0; kb < 6; kb++)
+      {
+        // C = alpha A B + beta C with all combinations of views for A and B, and for C
+        err = std::max (err, compareBlas<T> ([&] (T * m1, T * m2, T * m3, std::vector<T> & res)
+        {
+          withView (m1, ka, h, k, [&] (auto a) {
+            withView (m2, kb, k, w, [&] (auto b) {
+              withView (m3, (ka+kb) % 6, h, w, [&] (auto c) {
+                fill (a, 8); fill (b, 9); fill (c, 10);
+                blas::gemm (entry<T>(0.5, -0.5), a, b, entry<T>(2, 1), c);
+                store (c, res);
+              }); }); });
+        }));
+
+        // C = alpha A A^T + beta C on one triangle, B = A^{-1} B
+        for (auto uplo : { blas::Lower, blas::Upper })
+          err = std::max (err, compareBlas<T> ([&] (T * m1, T * m2, T * m3, std::vector<T> & res)
+          {
+            withView (m1, ka, h, k, [&] (auto a) {
+              withView (m2, kb, h, h, [&] (auto c) {
+                fill (a, 11); fill (c, 12);
+                blas::syrk (uplo, entry<T>(0.5, 0), a, entry<T>(-1, 2), c);
+                store (c, res);
+              }); });
+            withView (m3, kb, k, k, [&] (auto t) {
+              withView (m1, ka, k, w, [&] (auto b) {
+                fill (t, 13, 4.0); fill (b, 14);
+                blas::trsm (uplo, t, b, entry<T>(2, 0));
+                blas::trsm (uplo, t, b, entry<T>(1, 0), blas::Unit);
+                std::vector<T> resb;
+                store (b, resb);
+                res.insert (res.end(), resb.begin(), resb.end());
+              }); });
+          }));
+      }
+
+  cout << name << ": largest difference of library kernels and BLAS = " << err << endl;
+  return err <= tol;
+}
+
+
 int main()
 {
   Vector<double> x(5);
@@ -46,6 +228,73 @@ int main()
 
   cout << "a*b = " << c << endl;
 
+  // row major and transposed operands go to dgemm with the 'T' flag
+  Matrix<double,RowMajor> ar(2, 2), cr(2, 2);
+  ar = a;
+  multMatMatLapack(ar, b, cr);
+  cout << "a*b, a and c row major = " << endl << cr;
+  multMatMatLapack(Trans(b), Trans(a), Trans(c));
+  cout << "Trans(b)*Trans(a) into Trans(c) = " << endl << c << endl;
+
+  Matrix<double> s(3, 3);
+  for (size_t x = 0; x < 3; x++)
+    for (size_t y = 0; y < 3; y++)
+      s(x,y) = (x == y) ? 4 : x+y;
+  Vector<double> rhs(3);
+  rhs = 1.0;
+  LapackLU<RowMajor> lu { Matrix<double,RowMajor>(s) };
+  lu.solve(rhs);
+  cout << "s^{-1} (1,1,1) = " << rhs << endl;
+  cout << "s^{-1} = " << endl << LapackLU<ColMajor>(s).inverse() << endl;
+
+  // dgemm on a window of a larger matrix, with its leading dimension
+  {
+    Matrix<double> big(9, 11), cw(3, 4), cref(3, 4);
+    fill<double> (big, 1);
+    MatrixView<double> aw(9, 11, 5, 4, 2, 3, big.data());
+    MatrixView<double> bw(9, 11, 3, 5, 4, 1, big.data());
+    multMatMatLapack (aw, bw, cw);
+    cref = 0.0;
+    for (size_t j = 0; j < 3; j++)
+      for (size_t l = 0; l < 5; l++)
+        for (size_t i = 0; i < 4; i++)
+          cref(j,i) += aw(l,i) * bw(j,l);
+    std::vector<double> r1, r2;
+    store<double> (cw, r1);
+    store<double> (cref, r2);
+    cout << "multMatMatLapack on windows, error = " << relDiff(r1, r2) << endl;
+    if (relDiff(r1, r2) > 1e-14) return 1;
+  }
+
+  bool ok = testBlas<double>("double") & testBlas<float>("float")
+    & testBlas<std::complex<double>>("complex<double>") & testBlas<std::complex<float>>("complex<float>");
+  if (!ok)
+    {
+      cout << "BLAS dispatch test failed" << endl;
+      return 1;
+    }
+
+  // library gemm against BLAS gemm, to choose the threshold
+  size_t threshold = BlasThreshold();
+  for (size_t n : { 8, 16, 32, 64, 128, 256 })
+    {
+      Matrix<double> a(n, n), b(n, n), c(n, n);
+      fill<double> (a, 1); fill<double> (b, 2); c = 0.0;
+      size_t runs = 1 + size_t(1e9 / (n*n*n));
+      auto time = [&] (size_t threshold)
+      {
+        SetBlasThreshold (threshold);
+        auto start = std::chrono::high_resolution_clock::now();
+        for (size_t r = 0; r < runs; r++)
+          blas::gemm (1.0, a, b, 1.0, c);
+        auto end = std::chrono::high_resolution_clock::now();
+        return 2.0*n*n*n*runs / std::chrono::duration<double>(end-start).count() * 1e-9;
+      };
+      double lib = time (SIZE_MAX);
+      double blas = time (0);
+      cout << "gemm, n = " << n << ", GFlops: library " << lib << ", BLAS " << blas << endl;
+    }
+  SetBlasThreshold (threshold);
 
 }
 
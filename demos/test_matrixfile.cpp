@@ -0,0 +1,114 @@
+#include <iostream>
+#include <cstdio>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+
+#include <matrix.hpp>
+
+namespace bla = ASC_bla;
+
+/*
+  Round trip through a matrix file: save, load, map read-only,
+  map writable, write a matrix in column blocks, and row major files.
+*/
+
+int main()
+{
+  size_t h = 37, w = 23;
+  bla::Matrix<double> A(w, h);
+  for (size_t x = 0; x < w; x++)
+    for (size_t y = 0; y < h; y++)
+      A(x,y) = 1000*y + x;
+
+  auto diff = [] (const auto & a, const auto & b)
+  {
+    if (a.width() != b.width() || a.height() != b.height()) return 1e99;
+    double err = 0;
+    for (size_t x = 0; x < a.width(); x++)
+      for (size_t y = 0; y < a.height(); y++)
+        err = std::max(err, std::fabs(a(x,y)-b(x,y)));
+    return err;
+  };
+
+  std::string path = "test_matrixfile.mat";
+  bla::SaveMatrix (path, A);
+
+  bla::Matrix<double> B = bla::LoadMatrix<double> (path);
+  double err_load = diff(A, B);
+
+  double err_map, err_write;
+  bool aligned;
+  {
+    auto M = bla::Matrix<double>::mmap (path);
+    err_map = diff(A, M);
+    aligned = size_t(M.data()) % 4096 == 0;
+  }
+  {
+    auto M = bla::Matrix<double>::mmap (path, true);
+    M(3,4) = -1;
+  }
+  B = bla::LoadMatrix<double> (path);
+  err_write = std::fabs(B(3,4)+1);
+
+  // streaming: 3 columns at a time
+  {
+    bla::MatrixFileWriter<double> writer(path, h, w);
+    for (size_t x = 0; x < w; x += 3)
+      {
+        bla::Matrix<double> cols(std::min<size_t>(3, w-x), h);
+        for (size_t i = 0; i < cols.width(); i++)
+          for (size_t y = 0; y < h; y++)
+            cols(i,y) = A(x+i,y);
+        writer.append (cols);
+      }
+    writer.close();
+  }
+  double err_stream = diff(A, bla::LoadMatrix<double>(path));
+
+  // a row major matrix is saved as a 'C' file, and maps as a row major view
+  double err_rowmajor;
+  bool wrong_ordering = false;
+  {
+    bla::Matrix<double,bla::RowMajor> R(w, h);
+    R = A;
+    bla::SaveMatrix (path, R);
+    auto M = bla::Matrix<double,bla::RowMajor>::mmap (path);
+    err_rowmajor = std::max(diff(A, M), diff(A, bla::LoadMatrix<double>(path)));
+    try { bla::Matrix<double>::mmap (path); }
+    catch (std::exception & e) { wrong_ordering = true; }
+  }
+
+  bool wrong_type = false;
+  try { bla::LoadMatrix<float> (path); }
+  catch (std::exception & e) { wrong_type = true; std::cout << "expected error: " << e.what() << std::endl; }
+
+  // a header with a huge number of rows, and an empty file
+  int corrupt_rejected = 0;
+  {
+    bla::SaveMatrix (path, A);
+    {
+      std::fstream f(path, std::ios::in | std::ios::out | std::ios::binary);
+      uint64_t rows = uint64_t(1) << 62;
+      f.seekp (offsetof(bla::MatrixFileHeader, rows));
+      f.write (reinterpret_cast<const char*>(&rows), sizeof(rows));
+    }
+    try { bla::Matrix<double>::mmap (path); }
+    catch (std::exception & e) { corrupt_rejected++; std::cout << "expected error: " << e.what() << std::endl; }
+    try { bla::LoadMatrix<double> (path); }
+    catch (std::exception & e) { corrupt_rejected++; }
+    std::ofstream (path, std::ios::trunc);
+    try { bla::Matrix<double>::mmap (path); }
+    catch (std::exception & e) { corrupt_rejected++; std::cout << "expected error: " << e.what() << std::endl; }
+  }
+
+  std::remove (path.c_str());
+
+  std::cout << "save/load error = " << err_load << ", mmap error = " << err_map
+            << ", data page aligned = " << aligned << std::endl;
+  std::cout << "writable mmap error = " << err_write << ", streaming error = " << err_stream << std::endl;
+  std::cout << "row major error = " << err_rowmajor << std::endl;
+  return (err_load == 0 && err_map == 0 && err_write == 0 && err_stream == 0
+          && err_rowmajor == 0 && aligned && wrong_type && wrong_ordering && corrupt_rejected == 3) ? 0 : 1;
+}
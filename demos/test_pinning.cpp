@@ -0,0 +1,51 @@
+#include <iostream>
+#include <vector>
+
+#include <taskmanager.hpp>
+
+using namespace ASC_HPC;
+
+/*
+  Pinning orders on a fake machine with 2 sockets, 2 cores per socket
+  and 2 hyper-threads per core, in the two usual cpu numberings.
+*/
+
+static bool check (const char * name, Pinning policy, const std::vector<CpuTopology> & cpus,
+                   const std::vector<int> & expected)
+{
+  std::vector<int> order = PinningOrder (policy, cpus);
+  std::cout << name << ":";
+  for (int c : order) std::cout << " " << c;
+  bool ok = order == expected;
+  std::cout << (ok ? "" : "   wrong") << std::endl;
+  return ok;
+}
+
+int main()
+{
+  // hyper-thread siblings numbered after all cores (cpu 4 is the sibling of cpu 0)
+  std::vector<CpuTopology> split;
+  for (int smt = 0; smt < 2; smt++)
+    for (int socket = 0; socket < 2; socket++)
+      for (int core = 0; core < 2; core++)
+        split.push_back({ 4*smt + 2*socket + core, socket, core });
+
+  // siblings numbered next to each other (cpu 1 is the sibling of cpu 0)
+  std::vector<CpuTopology> adjacent;
+  for (int socket = 0; socket < 2; socket++)
+    for (int core = 0; core < 2; core++)
+      for (int smt = 0; smt < 2; smt++)
+        adjacent.push_back({ 4*socket + 2*core + smt, socket, core });
+
+  bool ok = true;
+  ok &= check ("compact, siblings split", Pinning::Compact, split, { 0, 1, 2, 3, 4, 5, 6, 7 });
+  ok &= check ("scatter, siblings split", Pinning::Scatter, split, { 0, 2, 1, 3, 4, 6, 5, 7 });
+  ok &= check ("compact, siblings adjacent", Pinning::Compact, adjacent, { 0, 2, 4, 6, 1, 3, 5, 7 });
+  ok &= check ("scatter, siblings adjacent", Pinning::Scatter, adjacent, { 0, 4, 2, 6, 1, 5, 3, 7 });
+
+  if (!ok)
+    {
+      std::cout << "pinning test failed" << std::endl;
+      return 1;
+    }
+}
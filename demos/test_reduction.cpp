@@ -0,0 +1,183 @@
+#include <iostream>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+#include <vector.hpp>
+#include <smallmatrix.hpp>
+
+namespace bla = ASC_bla;
+
+// one accumulator, as dot was before: bound by the latency of the add
+double dotScalar (const bla::Vector<double> & a, const bla::Vector<double> & b)
+{
+  double sum = 0;
+  for (size_t i = 0; i < a.size(); i++)
+    sum += a(i)*b(i);
+  return sum;
+}
+
+int main()
+{
+  bool ok = true;
+  auto check = [&ok] (const char * name, double err, double tol)
+  {
+    std::cout << name << ": error = " << err << std::endl;
+    ok = ok && err <= tol;
+  };
+
+  for (size_t n : { size_t(0), size_t(7), size_t(1000), size_t(1000003) })
+    {
+      std::cout << "n = " << n << std::endl;
+      bla::Vector<double> a(n), b(n);
+      long double dref = 0, sref = 0, nref = 0;
+      for (size_t i = 0; i < n; i++)
+        {
+          a(i) = std::sin(double(i));
+          b(i) = 1.0 / (1+i);
+          dref += (long double)(a(i))*b(i);
+          sref += a(i);
+          nref += (long double)(a(i))*a(i);
+        }
+      double scale = 1e-14 * std::max<double>(1, std::sqrt(double(n)));
+      check ("  dot(a,b)", std::fabs(dot(a, b) - double(dref)), scale);
+      check ("  Sum(a)", std::fabs(bla::Sum(a) - double(sref)), scale*n);
+      check ("  Norm(a)", std::fabs(bla::Norm(a) - std::sqrt(double(nref))), scale*std::sqrt(double(n)));
+      if (n == 0) continue;
+
+      // expressions and strided views
+      long double eref = 0;
+      for (size_t i = 0; i < n; i++)
+        eref += (a(i) + 2*b(i)) * b(i);
+      check ("  dot(a+2*b,b)", std::fabs(dot(a + 2*b, b) - double(eref)), scale);
+      long double stref = 0;
+      for (size_t i = 0; i < n/2; i++)
+        stref += (long double)(a(2*i))*b(2*i);
+      check ("  dot(a.slice,b.slice)", std::fabs(dot(a.slice(0,2), b.slice(0,2)) - double(stref)), scale);
+
+      // extreme entries, the first of equal ones
+      a(n/3) = 5.0;
+      a(n-1) = 5.0;
+      a(n/2) = -7.0;
+      auto [maxval, maxind] = bla::MaxIndex(a);
+      auto [minval, minind] = bla::MinIndex(a);
+      check ("  MaxIndex", std::fabs(maxval-5.0) + (maxind != n/3), 0);
+      check ("  MinIndex", std::fabs(minval+7.0) + (minind != n/2 && n/2 != n/3), 0);
+      check ("  MaxAbs", std::fabs(bla::MaxAbs(a)-7.0), 0);
+    }
+
+  // Norm neither overflows nor underflows
+  {
+    bla::Vector<double> big(100003), tiny(100003);
+    big = 1e200;
+    tiny = 1e-200;
+    double ref = std::sqrt(100003.0);
+    check ("Norm of 1e200", std::fabs(bla::Norm(big)/1e200 - ref) / ref, 1e-13);
+    check ("Norm of 1e-200", std::fabs(bla::Norm(tiny)/1e-200 - ref) / ref, 1e-13);
+  }
+
+  // small vectors use the same functions
+  {
+    bla::Vec<5> u(1, -2, 3, -4, 2);
+    check ("Vec<5>: dot, Norm, MaxAbs",
+           std::fabs(dot(u, u) - 34) + std::fabs(bla::Norm(u) - std::sqrt(34.0))
+           + std::fabs(bla::MaxAbs(u) - 4), 1e-15);
+  }
+
+  // DeterministicReduction gives the same bits for any number of threads
+  {
+    size_t n = 10000019;
+    bla::Vector<double> a(n), b(n);
+    for (size_t i = 0; i < n; i++)
+      {
+        a(i) = std::sin(0.001*i);
+        b(i) = std::cos(0.37*i);
+      }
+    double first = 0;
+    bool same = true;
+    for (int threads : { 1, 2, 3, 8 })
+      {
+        bla::SetReductionMode (bla::DeterministicReduction);
+        ASC_HPC::SetNumThreads (threads);
+        double d = dot(a, b);
+        if (threads == 1)
+          first = d;
+        same = same && std::memcmp(&d, &first, sizeof(d)) == 0;
+        bla::SetReductionMode (bla::FastReduction);
+        std::cout << "threads = " << threads << ": deterministic " << d
+                  << ", fast " << dot(a, b) << std::endl;
+      }
+    ASC_HPC::SetNumThreads (0);
+    check ("deterministic dot, difference between thread counts", !same, 0);
+  }
+
+  // CompensatedReduction: exact up to the final rounding on cancelling
+  // sums, the same bits for any number of threads
+  {
+    size_t n = 4000036;
+    bla::Vector<double> a(n), b(n), c(n);
+    // x*y = 1 - 2^-54 exactly, rounded to 1, the products cancel with -1
+    double x = 1 + std::ldexp(1.0, -27), y = 1 - std::ldexp(1.0, -27);
+    for (size_t i = 0; i < n; i++)
+      {
+        a(i) = (i % 2) ? 1.0 : x;
+        b(i) = (i % 2) ? -1.0 : y;
+        // 1 is lost against 1e16 unless compensated
+        c(i) = (i % 4 == 0) ? 1e16 : (i % 4 == 2) ? -1e16 : 1.0;
+      }
+    double exact_dot = -double(n/2) * std::ldexp(1.0, -54);
+    double exact_sum = double(n/2);
+    std::cout << "dot: exact " << exact_dot << ", fast " << dot(a, b)
+              << ", compensated " << dot(a, b, bla::CompensatedReduction) << std::endl;
+    std::cout << "sum: exact " << exact_sum << ", fast " << bla::Sum(c)
+              << ", compensated " << bla::Sum(c, bla::CompensatedReduction) << std::endl;
+    check ("compensated dot", std::fabs(dot(a, b, bla::CompensatedReduction) - exact_dot), 0);
+    check ("compensated sum", std::fabs(bla::Sum(c, bla::CompensatedReduction) - exact_sum), 0);
+
+    double first = 0;
+    bool same = true;
+    for (int threads : { 1, 2, 5, 8 })
+      {
+        ASC_HPC::SetNumThreads (threads);
+        double d = dot(a, b, bla::CompensatedReduction);
+        double s = bla::Sum(c, bla::CompensatedReduction);
+        if (threads == 1)
+          first = d;
+        same = same && std::memcmp(&d, &first, sizeof(d)) == 0;
+        std::cout << "threads = " << threads << ": compensated dot " << d << ", sum " << s << std::endl;
+      }
+    ASC_HPC::SetNumThreads (0);
+    check ("compensated dot, difference between thread counts", !same, 0);
+  }
+
+  if (!ok)
+    {
+      std::cout << "reduction test failed" << std::endl;
+      return 1;
+    }
+
+  // single accumulator loop against the SIMD accumulators
+  for (size_t n : { size_t(1000), size_t(100000), size_t(10000000) })
+    {
+      bla::Vector<double> a(n), b(n);
+      a = 1.0; b = 0.5;
+      size_t runs = 1 + size_t(2e9 / n);
+      auto time = [&] (auto f)
+      {
+        double sum = 0;
+        auto start = std::chrono::high_resolution_clock::now();
+        for (size_t r = 0; r < runs; r++)
+          sum += f();
+        auto end = std::chrono::high_resolution_clock::now();
+        if (sum != 0.5*n*runs) std::cout << "wrong sum" << std::endl;
+        return 2.0*n*runs / std::chrono::duration<double>(end-start).count() * 1e-9;
+      };
+      double scalar = time ([&] { return dotScalar(a, b); });
+      double fast = time ([&] { return dot(a, b); });
+      double det = time ([&] { return dot(a, b, bla::DeterministicReduction); });
+      double comp = time ([&] { return dot(a, b, bla::CompensatedReduction); });
+      std::cout << "dot, n = " << n << ", GFlops: one accumulator " << scalar
+                << ", SIMD " << fast << ", deterministic " << det
+                << ", compensated " << comp << std::endl;
+    }
+}
@@ -1,8 +1,94 @@
-#include<simd_functions.hpp>
+#include <iostream>
+#include <cstdint>
+
+#include <simd_functions.hpp>
 
 namespace bla = ASC_bla;
+using bla::SIMD;
+
+int errors = 0;
+
+void check (bool ok, const char * what)
+{
+  if (!ok)
+    {
+      std::cout << "FAILED: " << what << std::endl;
+      errors++;
+    }
+}
+
+template <typename T, size_t S>
+void testSIMD()
+{
+  alignas(64) T a[S], b[S], c[S];
+  for (size_t i = 0; i < S; i++)
+    {
+      a[i] = T(i+1);
+      b[i] = T(2*i);
+      c[i] = T(-1);
+    }
+
+  SIMD<T,S> sa = SIMD<T,S>::load_aligned(a);
+  SIMD<T,S> sb(b);
+  std::cout << "a = " << sa << ", b = " << sb << std::endl;
+
+  auto sum = sa+sb;
+  auto prod = sa*sb;
+  auto fma = FMA(sa, sb, SIMD<T,S>(T(1)));
+  T hsum = 0;
+  for (size_t i = 0; i < S; i++)
+    {
+      check(sum[i] == a[i]+b[i], "add");
+      check(prod[i] == a[i]*b[i], "mul");
+      check(fma[i] == a[i]*b[i]+T(1), "fma");
+      hsum += a[i];
+    }
+  check(HSum(sa) == hsum, "hsum");
+
+  auto mask = sa < sb;
+  auto sel = Select(mask, sa, sb);
+  std::cout << "a < b = " << mask << std::endl;
+  for (size_t i = 0; i < S; i++)
+    {
+      check(bool(mask[i]) == (a[i] < b[i]), "compare");
+      check(sel[i] == (a[i] < b[i] ? a[i] : b[i]), "select");
+    }
+
+  // masked load and store of the first S-1 lanes
+  auto first = SIMD<bla::simd_mask_t<T>,S>::mask_first(S-1);
+  SIMD<T,S> sm(a, first);
+  sm.store(c, first);
+  for (size_t i = 0; i < S; i++)
+    {
+      check(sm[i] == ((i < S-1) ? a[i] : T(0)), "masked load");
+      check(c[i] == ((i < S-1) ? a[i] : T(-1)), "masked store");
+    }
+
+  (sa+sb).store_aligned(c);
+  for (size_t i = 0; i < S; i++)
+    check(c[i] == a[i]+b[i], "aligned store");
+}
+
 
 int main()
 {
-    return 0;
+  testSIMD<double,1>();
+  testSIMD<double,2>();
+  testSIMD<double,3>();
+  testSIMD<double,4>();
+  testSIMD<double,8>();
+  testSIMD<double,12>();
+  testSIMD<float,4>();
+  testSIMD<float,8>();
+  testSIMD<float,12>();
+  testSIMD<float,16>();
+  testSIMD<int64_t,4>();
+  testSIMD<int64_t,8>();
+
+  std::cout << "native double width = " << bla::SIMD_WIDTH<double> << std::endl;
+  if (errors)
+    std::cout << errors << " errors" << std::endl;
+  else
+    std::cout << "all SIMD tests passed" << std::endl;
+  return errors ? 1 : 0;
 }
@@ -0,0 +1,141 @@
+#include <iostream>
+#include <chrono>
+#include <cmath>
+#include <vector>
+#include <mutex>
+
+#include <matrix.hpp>
+#include <taskmanager.hpp>
+
+namespace bla = ASC_bla;
+using ASC_HPC::TaskGraph;
+
+/*
+  Tiled Cholesky factorization A = L L^T through a task graph.
+  A is column major with leading dimension lda, only the lower part is used.
+  Every tile operation is a task depending on the last writers of its tiles,
+  so the factorization of a diagonal tile overlaps with the updates
+  of tiles further down.
+*/
+
+// L L^T = A for one tile
+void potrf (size_t n, double * a, size_t lda)
+{
+  for (size_t j = 0; j < n; j++)
+    {
+      double d = a[j*lda+j];
+      for (size_t k = 0; k < j; k++)
+        d -= a[k*lda+j] * a[k*lda+j];
+      d = std::sqrt(d);
+      a[j*lda+j] = d;
+      for (size_t i = j+1; i < n; i++)
+        {
+          double s = a[j*lda+i];
+          for (size_t k = 0; k < j; k++)
+            s -= a[k*lda+i] * a[k*lda+j];
+          a[j*lda+i] = s / d;
+        }
+    }
+}
+
+// B = B L^{-T}
+void trsm (size_t n, const double * l, double * b, size_t lda)
+{
+  for (size_t j = 0; j < n; j++)
+    {
+      for (size_t k = 0; k < j; k++)
+        for (size_t i = 0; i < n; i++)
+          b[j*lda+i] -= b[k*lda+i] * l[k*lda+j];
+      for (size_t i = 0; i < n; i++)
+        b[j*lda+i] /= l[j*lda+j];
+    }
+}
+
+// C -= A B^T
+void gemmNT (size_t n, const double * a, const double * b, double * c, size_t lda)
+{
+  bla::gemm (n, n, n, -1.0, a, 1, lda, b, lda, 1, 1.0, c, 1, lda);
+}
+
+
+void choleskyTiled (bla::Matrix<double> & A, size_t bs, TaskGraph & graph)
+{
+  size_t n = A.height();
+  size_t nt = n / bs;
+  size_t lda = A.dist();
+  auto tile = [&] (size_t i, size_t j) { return &A(j*bs, i*bs); };
+
+  std::vector<int> last(nt*nt, -1);   // last task writing tile (i,j)
+  auto deps = [&] (std::initializer_list<std::pair<size_t,size_t>> tiles)
+  {
+    std::vector<int> d;
+    for (auto [i,j] : tiles)
+      if (last[i*nt+j] >= 0) d.push_back(last[i*nt+j]);
+    return d;
+  };
+
+  for (size_t k = 0; k < nt; k++)
+    {
+      last[k*nt+k] = graph.addTask ([=] { potrf(bs, tile(k,k), lda); }, deps({{k,k}}));
+
+      for (size_t i = k+1; i < nt; i++)
+        last[i*nt+k] = graph.addTask ([=] { trsm(bs, tile(k,k), tile(i,k), lda); },
+                                      deps({{k,k}, {i,k}}));
+
+      for (size_t j = k+1; j < nt; j++)
+        for (size_t i = j; i < nt; i++)
+          last[i*nt+j] = graph.addTask ([=] { gemmNT(bs, tile(i,k), tile(j,k), tile(i,j), lda); },
+                                        deps({{i,k}, {j,k}, {i,j}}));
+    }
+  graph.wait();
+}
+
+
+int main()
+{
+  size_t n = 768, bs = 64;
+  bla::Matrix<double> A(n, n), L(n, n);
+
+  // symmetric and diagonally dominant
+  for (size_t x = 0; x < n; x++)
+    for (size_t y = 0; y < n; y++)
+      A(x,y) = (x == y) ? n : 1.0 / (1.0 + x + y);
+  L = A;
+
+  TaskGraph graph;
+  auto start = std::chrono::high_resolution_clock::now();
+  choleskyTiled (L, bs, graph);
+  auto end = std::chrono::high_resolution_clock::now();
+  double time = std::chrono::duration<double>(end-start).count();
+
+  // compare L L^T with A
+  double err = 0;
+  for (size_t x = 0; x < n; x++)
+    for (size_t y = x; y < n; y++)
+      {
+        double s = 0;
+        for (size_t k = 0; k <= x; k++)
+          s += L(k,y) * L(k,x);
+        err = std::max(err, std::fabs(s - A(x,y)));
+      }
+
+  std::cout << "tiled Cholesky, n = " << n << ", tiles " << bs
+            << ", threads = " << ASC_HPC::NumThreads()
+            << ", time = " << time << " s, GFlops = " << n*n*n/3.0/time*1e-9 << std::endl;
+  std::cout << "error |L L^T - A| = " << err << std::endl;
+
+  // dependencies are respected: each task sees the result of its predecessor
+  std::vector<int> order;
+  std::mutex m;
+  int prev = -1;
+  for (int i = 0; i < 100; i++)
+    prev = graph.addTask ([&, i] { std::lock_guard<std::mutex> lock(m); order.push_back(i); },
+                          (prev >= 0) ? std::vector<int>{prev} : std::vector<int>{});
+  graph.wait();
+  bool chain_ok = order.size() == 100;
+  for (size_t i = 0; i < order.size(); i++)
+    chain_ok = chain_ok && order[i] == int(i);
+  std::cout << "chain of 100 tasks " << (chain_ok ? "in order" : "OUT OF ORDER") << std::endl;
+
+  return (err < 1e-8 && chain_ok) ? 0 : 1;
+}
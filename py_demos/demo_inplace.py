@@ -0,0 +1,39 @@
+# iterations without temporaries: in-place operators, axpy and gemm with out
+import sys
+sys.path.append('../build/Debug')
+from time import time
+import bla
+
+n = 200
+A = bla.Matrix(n,n)
+A[(slice(0,n), slice(0,n))] = -1/n
+for i in range(n):
+    A[(i,i)] = 2
+
+# Richardson iteration for A X = B, all updates write into existing matrices
+B = bla.Matrix(n,n)
+B[(slice(0,n), slice(0,n))] = 1
+X = bla.Matrix(n,n)
+X[(slice(0,n), slice(0,n))] = 0
+R = bla.Matrix(n,n)
+
+ts = time()
+for it in range(50):
+    bla.gemm(A, X, out=R, alpha=-1)     # R = -A X
+    R += B                              # R = B - A X
+    R *= 0.4
+    X += R
+print ("matrix iteration:", time()-ts, "s, residual entry", R[(0,0)])
+
+# vectors: x += 0.5*(b - x) with axpy
+x = bla.Vector(n)
+b = bla.Vector(n)
+r = bla.Vector(n)
+x[:] = 0
+b[:] = 1
+for it in range(30):
+    r[:] = 0
+    r += b
+    r -= x
+    bla.axpy(0.5, r, x)
+print ("x[0] =", x[0])
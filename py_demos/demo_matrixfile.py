@@ -0,0 +1,38 @@
+# matrix files: save, load, memory mapping and streaming
+import sys
+sys.path.append('../build/Debug')
+import os
+import bla
+
+n = 1000
+A = bla.Matrix(n, n)
+A[(slice(0,n), slice(0,n))] = 1
+A[(2,3)] = 5
+
+A.save("A.mat")
+B = bla.load_matrix("A.mat")
+print ("loaded:", B.shape, B[(2,3)])
+
+# read-only mapping, shared with other processes mapping the same file
+M = bla.Matrix.mmap("A.mat")
+print ("mapped:", M.shape, M[(2,3)], "writable:", M.writable)
+C = M*M
+print ("(M*M)[2,3] =", C[(2,3)])
+try:
+    M[(0,0)] = 7
+except ValueError as e:
+    print ("expected error:", e)
+del M
+
+# write a matrix in blocks of 100 columns
+with bla.MatrixFileWriter("S.mat", n, n) as writer:
+    for j in range(0, n, 100):
+        block = bla.Matrix(100, n)
+        block[(slice(0,n), slice(0,100))] = j
+        writer.append(block)
+S = bla.Matrix.mmap("S.mat")
+print ("streamed:", S[(0,0)], S[(0,999)])
+del S
+
+os.remove("A.mat")
+os.remove("S.mat")
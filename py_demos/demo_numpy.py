@@ -0,0 +1,42 @@
+# search for libraray like bla.cpython-312-darwin.so in the build directory:
+import sys
+sys.path.append('../build/Debug')
+from time import time
+import numpy as np
+import bla
+
+# NumPy views of bla objects
+x = bla.Vector(5)
+x[:] = 1
+xa = np.asarray(x)
+xa[2] = 7
+print ("x =", x)
+
+A = bla.Matrix(3, 2)                 # width 3, height 2
+A[(slice(0,2), slice(0,3))] = 0
+A[(1,2)] = 5
+print ("A as array =\n", np.asarray(A), np.asarray(A).shape)
+
+# bla views of NumPy arrays
+a = np.asfortranarray(np.arange(6.0).reshape(2,3))
+Av = bla.MatrixView(a)
+Av[(0,0)] = -1
+print ("a after writing through the view =\n", a)
+print ("column slice:", bla.MatrixView(a[:, ::2]).shape)
+
+# copies and views of a large vector
+n = 10**6
+v = np.random.rand(n)
+
+ts = time()
+for i in range(10):
+    xv = bla.VectorView(v)
+    va = np.asarray(xv)
+print ("view both ways:   ", (time()-ts)/10*1e6, "us")
+
+ts = time()
+for i in range(10):
+    xc = bla.Vector(v)
+print ("copy into Vector: ", (time()-ts)/10*1e6, "us")
+
+assert np.allclose(np.asarray((bla.Vector(v) + bla.VectorView(v)).eval()), 2*v)
@@ -0,0 +1,29 @@
+# pickling vectors and matrices, in-band and with out-of-band buffers
+import sys
+sys.path.append('../build/Debug')
+import pickle
+from time import time
+import bla
+
+n = 2000
+A = bla.Matrix(n, n)
+A[(slice(0,n), slice(0,n))] = 1
+A[(3,4)] = 7
+
+# protocol 4: the data is copied into bytes
+ts = time()
+s4 = pickle.dumps(A, protocol=4)
+B = pickle.loads(s4)
+print ("protocol 4:  ", time()-ts, "s, size", len(s4), "B[3,4] =", B[(3,4)])
+
+# protocol 5 with buffer_callback: the pickle holds only the header,
+# the memory of A is handed over as a PickleBuffer without copying
+ts = time()
+buffers = []
+s5 = pickle.dumps(A, protocol=5, buffer_callback=buffers.append)
+B = pickle.loads(s5, buffers=buffers)
+print ("protocol 5:  ", time()-ts, "s, size", len(s5), "B[3,4] =", B[(3,4)])
+
+x = bla.Vector(5)
+x[:] = 3
+print ("vector:", pickle.loads(pickle.dumps(x, protocol=5)))
@@ -0,0 +1,36 @@
+# matrix products from concurrent Python threads
+# the products run without the GIL, so the threads overlap
+from time import time
+from concurrent.futures import ThreadPoolExecutor
+
+import sys
+sys.path.append('../build/Debug')
+import bla
+
+n = 512
+runs = 8
+
+A = bla.Matrix(n,n)
+B = bla.Matrix(n,n)
+A[(slice(0,n), slice(0,n))] = 1
+B[(slice(0,n), slice(0,n))] = 2
+
+def work(k):
+    for i in range(runs):
+        C = A*B
+    return k
+
+for inner in [1, 0]:
+    # inner = 1: one thread per product, 0: the default pool inside every product
+    with bla.TaskManager(inner):
+        print ("threads inside a product:", bla.num_threads())
+        base = None
+        for nthreads in [1, 2, 4, 8]:
+            ts = time()
+            with ThreadPoolExecutor(nthreads) as ex:
+                list(ex.map(work, range(nthreads)))
+            te = time()
+            rate = nthreads*runs / (te-ts)
+            base = base or rate
+            print ("  python threads =", nthreads, " products/s =", round(rate,2),
+                   " speedup =", round(rate/base,2))
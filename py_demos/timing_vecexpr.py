@@ -0,0 +1,33 @@
+# x + 3*y + 2*z: fused evaluation of the expression,
+# compared to a new vector for every intermediate result
+from time import time
+
+import sys
+sys.path.append('../build/Debug')
+import bla
+
+for n in [10**4, 10**5, 10**6, 10**7]:
+    x = bla.Vector(n)
+    y = bla.Vector(n)
+    z = bla.Vector(n)
+    w = bla.Vector(n)
+    x[:] = 1
+    y[:] = 2
+    z[:] = 3
+    runs = max(1, 10**8 // n // 10)
+
+    ts = time()
+    for i in range(runs):
+        t1 = (3*y).eval()
+        t2 = (x+t1).eval()
+        t3 = (2*z).eval()
+        w[:] = t2+t3
+    t_steps = (time()-ts)/runs
+
+    ts = time()
+    for i in range(runs):
+        w[:] = x + 3*y + 2*z
+    t_fused = (time()-ts)/runs
+
+    print ("n =", n, " step by step:", t_steps, " fused:", t_fused,
+           " speedup:", round(t_steps/t_fused, 2), " w[0] =", w[0])
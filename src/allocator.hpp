@@ -0,0 +1,169 @@
+#ifndef FILE_ALLOCATOR
+#define FILE_ALLOCATOR
+
+#include <cstddef>
+#include <new>
+#include <vector>
+#include <array>
+#include <algorithm>
+
+
+/*
+  Aligned memory for Vector and Matrix.
+
+  Requests are rounded up to size classes, four per power of two.
+  Freed blocks go into a free list of the freeing thread and are handed
+  out again for the next request of the same class, so temporaries of
+  the same shape created in a loop do not go to malloc. Each thread
+  keeps at most MAX_CACHED_BYTES, larger blocks are never cached.
+*/
+
+#ifndef ASC_ALIGNMENT
+#define ASC_ALIGNMENT 64
+#endif
+
+namespace ASC_bla
+{
+
+  template <size_t ALIGN>
+  class MemoryPool
+  {
+  public:
+    static constexpr size_t MAX_CACHED_BYTES = size_t(1) << 26;
+    static constexpr size_t MIN_BYTES = (ALIGN > 64) ? ALIGN : 64;
+    static constexpr size_t NUM_CLASSES = 4*64;
+
+    // class number, and the bytes of the class
+    static size_t sizeClass (size_t bytes, size_t & class_bytes)
+    {
+      if (bytes <= MIN_BYTES)
+        {
+          class_bytes = MIN_BYTES;
+          return 0;
+        }
+      // 2^lg < bytes <= 2^(lg+1), split into 4 steps
+      int lg = 0;
+      while ((size_t(2) << lg) < bytes) lg++;
+      size_t low = size_t(1) << lg;
+      size_t step = std::max(low / 4, MIN_BYTES);
+      size_t sub = (bytes-low+step-1) / step;
+      class_bytes = low + sub*step;
+      return 4*lg + sub;
+    }
+
+    static void * allocate (size_t bytes)
+    {
+      size_t class_bytes;
+      size_t cl = sizeClass (bytes, class_bytes);
+      if (class_bytes > MAX_CACHED_BYTES)
+        return ::operator new(bytes, std::align_val_t(ALIGN));
+
+      if (ThreadCache * cache = Cache())
+        {
+          auto & list = cache->free[cl];
+          if (list.size())
+            {
+              void * p = list.back();
+              list.pop_back();
+              cache->bytes -= class_bytes;
+              return p;
+            }
+        }
+      return ::operator new(class_bytes, std::align_val_t(ALIGN));
+    }
+
+    static void deallocate (void * p, size_t bytes)
+    {
+      if (!p) return;
+      size_t class_bytes;
+      size_t cl = sizeClass (bytes, class_bytes);
+      ThreadCache * cache = (class_bytes > MAX_CACHED_BYTES) ? nullptr : Cache();
+      if (!cache || cache->bytes+class_bytes > MAX_CACHED_BYTES)
+        {
+          ::operator delete(p, std::align_val_t(ALIGN));
+          return;
+        }
+      cache->free[cl].push_back(p);
+      cache->bytes += class_bytes;
+    }
+
+    // give the blocks cached by the calling thread back to the system
+    static void release()
+    {
+      if (ThreadCache * cache = Cache())
+        cache->clear();
+    }
+
+  private:
+    struct ThreadCache
+    {
+      std::array<std::vector<void*>, NUM_CLASSES> free;
+      size_t bytes = 0;
+
+      void clear()
+      {
+        for (auto & list : free)
+          {
+            for (void * p : list)
+              ::operator delete(p, std::align_val_t(ALIGN));
+            list.clear();
+          }
+        bytes = 0;
+      }
+      ~ThreadCache()
+      {
+        clear();
+        CacheDestroyed() = true;
+      }
+    };
+
+    /*
+      The cache of the calling thread, nullptr after it was destroyed at
+      thread exit: static vectors and matrices are freed after the cache
+      of the main thread, they go to the system directly.
+    */
+    static bool & CacheDestroyed()
+    {
+      thread_local bool destroyed = false;
+      return destroyed;
+    }
+
+    static ThreadCache * Cache()
+    {
+      if (CacheDestroyed()) return nullptr;
+      thread_local ThreadCache cache;
+      return &cache;
+    }
+  };
+
+
+  // standard allocator interface to the MemoryPool
+  template <typename T, size_t ALIGN = ASC_ALIGNMENT>
+  class PoolAllocator
+  {
+  public:
+    typedef T value_type;
+    template <typename U> struct rebind { typedef PoolAllocator<U,ALIGN> other; };
+
+    PoolAllocator() = default;
+    template <typename U>
+    PoolAllocator (const PoolAllocator<U,ALIGN> &) { }
+
+    T * allocate (size_t n)
+    {
+      return static_cast<T*> (MemoryPool<ALIGN>::allocate(n*sizeof(T)));
+    }
+    void deallocate (T * p, size_t n)
+    {
+      MemoryPool<ALIGN>::deallocate(p, n*sizeof(T));
+    }
+
+    template <typename U>
+    bool operator== (const PoolAllocator<U,ALIGN> &) const { return true; }
+    template <typename U>
+    bool operator!= (const PoolAllocator<U,ALIGN> &) const { return false; }
+  };
+
+}
+
+#endif
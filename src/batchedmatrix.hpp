@@ -0,0 +1,344 @@
+#ifndef FILE_BATCHEDMATRIX
+#define FILE_BATCHEDMATRIX
+
+#include <algorithm>
+#include <atomic>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "matrix.hpp"
+#include "simd_functions.hpp"
+#include "taskmanager.hpp"
+
+/*
+  A batch of equally sized small matrices, e.g. the element matrices of
+  a mesh. SW = SIMD_WIDTH<T> consecutive members form a block, and inside
+  a block entry (x,y) of all members is stored side by side, an "array
+  of structures of arrays":
+
+    data[(block*width*height + x*height + y)*SW + lane]
+
+  The batched functions load one register per entry and treat SW members
+  with the index arithmetic of a single matrix. Large batches are split
+  into ranges of blocks for the ASC_HPC workers. Lanes behind the last
+  member are padding, they are zero initially and never reported.
+*/
+
+namespace ASC_bla
+{
+
+  template <typename T, typename ALLOC = PoolAllocator<T>>
+  class BatchedMatrix
+  {
+    static_assert (std::is_same_v<T,double> || std::is_same_v<T,float>,
+                   "BatchedMatrix is implemented for float and double");
+  public:
+    static constexpr size_t SW = SIMD_WIDTH<T>;
+
+  private:
+    size_t m_batch;
+    size_t m_width;
+    size_t m_height;
+    T * m_data;
+
+    size_t numEntries() const { return blocks()*m_width*m_height*SW; }
+
+  public:
+    BatchedMatrix (size_t batch, size_t width, size_t height)
+      : m_batch(batch), m_width(width), m_height(height),
+        m_data(ALLOC().allocate(numEntries()))
+    {
+      std::uninitialized_fill_n (m_data, numEntries(), T(0));
+    }
+
+    BatchedMatrix (const BatchedMatrix & m)
+      : BatchedMatrix(m.m_batch, m.m_width, m.m_height)
+    {
+      *this = m;
+    }
+
+    BatchedMatrix (BatchedMatrix && m)
+      : m_batch(0), m_width(0), m_height(0), m_data(nullptr)
+    {
+      *this = std::move(m);
+    }
+
+    ~BatchedMatrix ()
+    {
+      if (!m_data) return;
+      ALLOC().deallocate (m_data, numEntries());
+    }
+
+    BatchedMatrix & operator= (const BatchedMatrix & m2)
+    {
+      assert (m_batch == m2.m_batch && m_width == m2.m_width && m_height == m2.m_height);
+      std::copy_n (m2.m_data, numEntries(), m_data);
+      return *this;
+    }
+
+    BatchedMatrix & operator= (BatchedMatrix && m2)
+    {
+      std::swap (m_batch, m2.m_batch);
+      std::swap (m_width, m2.m_width);
+      std::swap (m_height, m2.m_height);
+      std::swap (m_data, m2.m_data);
+      return *this;
+    }
+
+    size_t batch() const { return m_batch; }
+    size_t width() const { return m_width; }
+    size_t height() const { return m_height; }
+    size_t blocks() const { return (m_batch+SW-1) / SW; }
+
+    T * data() const { return m_data; }
+    // entries of members SW*i ... SW*i+SW-1
+    T * block (size_t i) const { return m_data + i*m_width*m_height*SW; }
+
+    T & operator()(size_t b, size_t x, size_t y) { return block(b/SW)[(x*m_height+y)*SW + b%SW]; }
+    const T & operator()(size_t b, size_t x, size_t y) const { return block(b/SW)[(x*m_height+y)*SW + b%SW]; }
+
+    // member b as a strided view: rows are SW apart, columns height*SW
+    MatrixView<T> operator[] (size_t b) const
+    {
+      return MatrixView<T> (m_width, m_height*SW, 1, SW, block(b/SW) + b%SW);
+    }
+  };
+
+
+  namespace batched_detail
+  {
+    // flops from which a batched operation is split over the workers
+    constexpr size_t PARALLEL_WORK = size_t(1) << 16;
+
+    // func(first, next) on ranges of the blocks
+    template <typename F>
+    void forBlocks (size_t blocks, size_t work_per_block, F func)
+    {
+      if (blocks*work_per_block < PARALLEL_WORK)
+        {
+          func (0, blocks);
+          return;
+        }
+      int pieces = std::min<size_t> (4*ASC_HPC::NumThreads(), blocks);
+      ASC_HPC::RunParallel (pieces, [blocks, &func] (int nr, int size)
+      {
+        func (blocks*nr/size, blocks*(nr+1)/size);
+      });
+    }
+
+    template <typename T, size_t S>
+    SIMD<T,S> abs (SIMD<T,S> a) { return Select (a < SIMD<T,S>(T(0)), -a, a); }
+
+    template <typename TM, size_t S>
+    bool any (SIMD<TM,S> mask)
+    {
+      for (size_t i = 0; i < S; i++)
+        if (bool(mask[i])) return true;
+      return false;
+    }
+
+    // c = a*b for one block, a is h x k, b is k x w
+    template <typename T>
+    void gemmBlock (const T * a, const T * b, T * c, size_t h, size_t k, size_t w)
+    {
+      constexpr size_t SW = SIMD_WIDTH<T>;
+      typedef SIMD<T,SW> ST;
+      for (size_t x = 0; x < w; x++)
+        {
+          const T * bx = b + x*k*SW;
+          T * cx = c + x*h*SW;
+          size_t y = 0;
+          // four rows at once, for independent accumulators
+          for ( ; y+4 <= h; y += 4)
+            {
+              ST s0(T(0)), s1(T(0)), s2(T(0)), s3(T(0));
+              for (size_t l = 0; l < k; l++)
+                {
+                  ST bl = ST::load_aligned(bx + l*SW);
+                  const T * al = a + (l*h+y)*SW;
+                  s0 = FMA(ST::load_aligned(al), bl, s0);
+                  s1 = FMA(ST::load_aligned(al+SW), bl, s1);
+                  s2 = FMA(ST::load_aligned(al+2*SW), bl, s2);
+                  s3 = FMA(ST::load_aligned(al+3*SW), bl, s3);
+                }
+              s0.store_aligned(cx + y*SW);
+              s1.store_aligned(cx + (y+1)*SW);
+              s2.store_aligned(cx + (y+2)*SW);
+              s3.store_aligned(cx + (y+3)*SW);
+            }
+          for ( ; y < h; y++)
+            {
+              ST s(T(0));
+              for (size_t l = 0; l < k; l++)
+                s = FMA(ST::load_aligned(a + (l*h+y)*SW), ST::load_aligned(bx + l*SW), s);
+              s.store_aligned(cx + y*SW);
+            }
+        }
+    }
+
+    /*
+      Solves a x = b for one block with partial pivoting, lane by lane:
+      a (n x n) is replaced by its LU factors with the rows exchanged,
+      b (n x m) by the solution. Returns the first of the lanes < valid
+      with a singular matrix, or SW. Zero pivots are replaced by one, so
+      singular and padding lanes give garbage, but no infinities.
+    */
+    template <typename T>
+    size_t luSolveBlock (T * a, T * b, size_t n, size_t m, size_t valid)
+    {
+      constexpr size_t SW = SIMD_WIDTH<T>;
+      typedef SIMD<T,SW> ST;
+      auto pa = [a,n] (size_t x, size_t y) { return a + (x*n+y)*SW; };
+      auto pb = [b,n] (size_t x, size_t y) { return b + (x*n+y)*SW; };
+      auto swapRows = [] (T * p, T * q, auto mask)
+      {
+        ST vp = ST::load_aligned(p), vq = ST::load_aligned(q);
+        Select(mask, vq, vp).store_aligned(p);
+        Select(mask, vp, vq).store_aligned(q);
+      };
+
+      size_t singular = SW;
+      for (size_t k = 0; k < n; k++)
+        {
+          // the row of the largest entry of column k, as a T per lane
+          ST pmax = abs(ST::load_aligned(pa(k,k)));
+          ST piv = ST(T(k));
+          for (size_t i = k+1; i < n; i++)
+            {
+              ST v = abs(ST::load_aligned(pa(k,i)));
+              auto larger = v > pmax;
+              pmax = Select(larger, v, pmax);
+              piv = Select(larger, ST(T(i)), piv);
+            }
+
+          auto zero = pmax == ST(T(0));
+          if (any(zero))
+            for (size_t l = 0; l < std::min(valid, singular); l++)
+              if (bool(zero[l])) singular = l;
+
+          for (size_t i = k+1; i < n; i++)
+            {
+              auto exchange = piv == ST(T(i));
+              if (!any(exchange)) continue;
+              for (size_t x = 0; x < n; x++)
+                swapRows (pa(x,k), pa(x,i), exchange);
+              for (size_t x = 0; x < m; x++)
+                swapRows (pb(x,k), pb(x,i), exchange);
+            }
+
+          ST diag = Select(zero, ST(T(1)), ST::load_aligned(pa(k,k)));
+          diag.store_aligned(pa(k,k));
+          ST inv = ST(T(1)) / diag;
+          for (size_t i = k+1; i < n; i++)
+            {
+              ST f = ST::load_aligned(pa(k,i)) * inv;
+              f.store_aligned(pa(k,i));
+              for (size_t x = k+1; x < n; x++)
+                (ST::load_aligned(pa(x,i)) - f * ST::load_aligned(pa(x,k))).store_aligned(pa(x,i));
+              for (size_t x = 0; x < m; x++)
+                (ST::load_aligned(pb(x,i)) - f * ST::load_aligned(pb(x,k))).store_aligned(pb(x,i));
+            }
+        }
+
+      // back substitution with the upper triangle
+      for (size_t k = n; k-- > 0; )
+        {
+          ST inv = ST(T(1)) / ST::load_aligned(pa(k,k));
+          for (size_t x = 0; x < m; x++)
+            {
+              ST v = ST::load_aligned(pb(x,k));
+              for (size_t j = k+1; j < n; j++)
+                v -= ST::load_aligned(pa(j,k)) * ST::load_aligned(pb(x,j));
+              (v * inv).store_aligned(pb(x,k));
+            }
+        }
+      return singular;
+    }
+
+    inline void throwSingular (const char * func, size_t member)
+    {
+      throw std::runtime_error (std::string(func) + ": batch member "
+                                + std::to_string(member) + " is singular");
+    }
+  }
+
+
+  // C_b = A_b * B_b for every member b, C must not be A or B
+  template <typename T, typename ALLOC>
+  void BatchedGemm (const BatchedMatrix<T,ALLOC> & A, const BatchedMatrix<T,ALLOC> & B,
+                    BatchedMatrix<T,ALLOC> & C)
+  {
+    assert (A.batch() == B.batch() && A.batch() == C.batch());
+    assert (A.width() == B.height() && C.height() == A.height() && C.width() == B.width());
+    assert (C.data() != A.data() && C.data() != B.data());
+    size_t h = A.height(), k = A.width(), w = B.width();
+    batched_detail::forBlocks (A.blocks(), 2*h*k*w*A.SW, [&] (size_t first, size_t next)
+    {
+      for (size_t i = first; i < next; i++)
+        batched_detail::gemmBlock (A.block(i), B.block(i), C.block(i), h, k, w);
+    });
+  }
+
+
+  /*
+    Solves A_b X_b = B_b for every member b, with partial pivoting.
+    A is overwritten by the LU factors (with the rows exchanged), B by
+    the solutions. Throws if a member is singular.
+  */
+  template <typename T, typename ALLOC>
+  void BatchedLUSolve (BatchedMatrix<T,ALLOC> & A, BatchedMatrix<T,ALLOC> & B)
+  {
+    assert (A.batch() == B.batch());
+    assert (A.width() == A.height() && B.height() == A.height());
+    size_t n = A.height(), m = B.width(), batch = A.batch();
+    constexpr size_t SW = BatchedMatrix<T,ALLOC>::SW;
+    std::atomic<size_t> singular(batch);
+    batched_detail::forBlocks (A.blocks(), n*n*(n+3*m), [&] (size_t first, size_t next)
+    {
+      for (size_t i = first; i < next; i++)
+        {
+          size_t lane = batched_detail::luSolveBlock (A.block(i), B.block(i), n, m,
+                                                      std::min(SW, batch-i*SW));
+          size_t member = i*SW + lane, prev = singular;
+          while (lane < SW && member < prev && !singular.compare_exchange_weak(prev, member)) ;
+        }
+    });
+    if (singular < batch)
+      batched_detail::throwSingular ("BatchedLUSolve", singular);
+  }
+
+
+  // replaces every member of A by its inverse, throws if one is singular
+  template <typename T, typename ALLOC>
+  void BatchedInverse (BatchedMatrix<T,ALLOC> & A)
+  {
+    assert (A.width() == A.height());
+    size_t n = A.height(), batch = A.batch();
+    constexpr size_t SW = BatchedMatrix<T,ALLOC>::SW;
+    std::atomic<size_t> singular(batch);
+    batched_detail::forBlocks (A.blocks(), 4*n*n*n, [&] (size_t first, size_t next)
+    {
+      // one block of LU factors per range, the inverse is solved into A
+      std::vector<T,PoolAllocator<T>> lu(n*n*SW);
+      for (size_t i = first; i < next; i++)
+        {
+          T * a = A.block(i);
+          std::copy_n (a, n*n*SW, lu.data());
+          std::fill_n (a, n*n*SW, T(0));
+          for (size_t d = 0; d < n; d++)
+            std::fill_n (a + (d*n+d)*SW, SW, T(1));
+          size_t lane = batched_detail::luSolveBlock (lu.data(), a, n, n,
+                                                      std::min(SW, batch-i*SW));
+          size_t member = i*SW + lane, prev = singular;
+          while (lane < SW && member < prev && !singular.compare_exchange_weak(prev, member)) ;
+        }
+    });
+    if (singular < batch)
+      batched_detail::throwSingular ("BatchedInverse", singular);
+  }
+
+}
+
+#endif
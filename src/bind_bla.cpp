@@ -1,52 +1,493 @@
 #include <sstream>
+#include <optional>
+#include <cstring>
+#include <cstdint>
+#include <limits>
 #include <pybind11/pybind11.h>
 
 #include "vector.hpp"
 #include "matrix.hpp"
+#include "taskmanager.hpp"
 
 using namespace ASC_bla;
 namespace py = pybind11;
 
 
+// the pool is started by __enter__, not by the constructor
+struct PyTaskManager
+{
+  int num_threads;
+  std::unique_ptr<ASC_HPC::TaskManager> tm;
+};
 
 
-PYBIND11_MODULE(bla, m) {
-    m.doc() = "Basic linear algebra module"; // optional module docstring
-    
-    py::class_<Vector<double>> (m, "Vector")
-      .def(py::init<size_t>(),
-           py::arg("size"), "create vector of given size")
-      .def("__len__", &Vector<double>::size,
+// views into memory owned by someone else, e.g. a NumPy array
+typedef VectorView<double, size_t> PyVectorView;
+typedef MatrixView<double> PyMatrixView;
+
+
+// buffer of doubles with ndim dimensions, strides converted to elements
+static py::buffer_info requestDoubles (py::buffer b, int ndim, bool writable,
+                                       std::vector<size_t> & strides)
+{
+  py::buffer_info info = b.request(writable);
+  if (info.format != py::format_descriptor<double>::format() || info.itemsize != sizeof(double))
+    throw py::type_error("expected a buffer of float64, got format '" + info.format + "'");
+  if (info.ndim != ndim)
+    throw py::value_error("expected a buffer with " + std::to_string(ndim) + " dimensions");
+  strides.clear();
+  for (auto s : info.strides)
+    {
+      if (s < 0 || s % sizeof(double) != 0)
+        throw py::value_error("strides must be non-negative multiples of the item size");
+      strides.push_back(s / sizeof(double));
+    }
+  return info;
+}
+
+static PyVectorView wrapVector (py::buffer b)
+{
+  std::vector<size_t> strides;
+  py::buffer_info info = requestDoubles (b, 1, true, strides);
+  return PyVectorView (info.shape[0], strides[0], static_cast<double*>(info.ptr));
+}
+
+/*
+  MatrixView addresses element (x,y) at dist_x*x*height + dist_y*y,
+  so the column stride has to be a multiple of rows times the row stride.
+  That covers Fortran ordered arrays and column slices of them.
+*/
+static PyMatrixView wrapMatrix (py::buffer b)
+{
+  std::vector<size_t> strides;
+  py::buffer_info info = requestDoubles (b, 2, true, strides);
+  size_t rows = info.shape[0], cols = info.shape[1];
+  // no entries: any strides are valid
+  if (rows == 0 || cols == 0)
+    return PyMatrixView (cols, rows, 1, 1, static_cast<double*>(info.ptr));
+  size_t rs = (rows > 1) ? strides[0] : 1;
+  size_t cs = strides[1];
+  size_t dist_x = 1;
+  if (rs == 0)
+    throw py::value_error("cannot wrap a matrix with row stride 0");
+  if (cols > 1)
+    {
+      if (cs == 0 || cs % (rows*rs) != 0)
+        throw py::value_error("only column major (Fortran ordered) arrays can be wrapped "
+                              "without copying, use numpy.asfortranarray or bla.Matrix(array)");
+      dist_x = cs / (rows*rs);
+    }
+  return PyMatrixView (cols*dist_x, rows*rs, dist_x, rs, static_cast<double*>(info.ptr));
+}
+
+static py::buffer_info vectorBuffer (const PyVectorView & v)
+{
+  return py::buffer_info (v.data(), sizeof(double), py::format_descriptor<double>::format(), 1,
+                          { py::ssize_t(v.size()) },
+                          { py::ssize_t(v.dist()*sizeof(double)) });
+}
+
+// shape is (rows, columns) as in NumPy, element (i,j) is self(j,i)
+static py::buffer_info matrixBuffer (PyMatrixView & m, bool readonly = false)
+{
+  double * first = (m.width() && m.height()) ? &m(0,0) : m.data();
+  return py::buffer_info (first, sizeof(double), py::format_descriptor<double>::format(), 2,
+                          { py::ssize_t(m.height()), py::ssize_t(m.width()) },
+                          { py::ssize_t(m.row_dist()*sizeof(double)),
+                            py::ssize_t(m.col_dist()*sizeof(double)) },
+                          readonly);
+}
+
+// the matrix behind h, if it may be written to (files can be mapped read-only)
+static PyMatrixView & writableMatrix (py::handle h)
+{
+  if (py::isinstance<MappedMatrix<double>>(h) && !h.cast<MappedMatrix<double>&>().writable())
+    throw py::value_error("matrix is mapped read-only");
+  return h.cast<PyMatrixView&>();
+}
+
+
+template <typename TA, typename TB>
+void checkSizes (const VecExpr<TA> & a, const VecExpr<TB> & b)
+{
+  if (a.size() != b.size())
+    throw py::value_error("vector sizes do not match");
+}
+
+template <typename TA, typename TB>
+void checkSizes (const MatrixExpr<TA> & a, const MatrixExpr<TB> & b)
+{
+  if (a.width() != b.width() || a.height() != b.height())
+    throw py::value_error("matrix shapes do not match");
+}
+
+
+/*
+  Pickle format: _unpickle(header, data) with the header
+    (PICKLE_VERSION, kind, dtype, order, shape)
+  where kind is "Vector" or "Matrix", dtype is "<f8" or ">f8", order
+  is "F" and shape is (size,) or (rows, columns). data holds the entries
+  contiguously. With protocol 5 data is a PickleBuffer of the object
+  itself, so pickle.dumps(..., buffer_callback=...) passes the memory
+  to the transport without copying. Older protocols copy it into bytes.
+  Loading copies the data once into new aligned memory.
+  Pickles of the old (size, bytes) form still load through __setstate__.
+*/
+constexpr int PICKLE_VERSION = 1;
+
+static std::string nativeDtype()
+{
+  uint16_t one = 1;
+  return (*reinterpret_cast<const char*>(&one) == 1) ? "<f8" : ">f8";
+}
+
+static py::tuple reduceEx (py::object self, int protocol, const char * kind,
+                           py::tuple shape, const double * data, size_t n)
+{
+  py::tuple header = py::make_tuple (PICKLE_VERSION, kind, nativeDtype(), "F", shape);
+  py::object buffer;
+  if (protocol >= 5)
+    buffer = py::module_::import("pickle").attr("PickleBuffer")(self);
+  else
+    buffer = py::bytes (reinterpret_cast<const char*>(data), n*sizeof(double));
+  // the module may be imported under a package name
+  py::object module = py::module_::import(py::str(py::type::of(self).attr("__module__")));
+  return py::make_tuple (module.attr("_unpickle"), py::make_tuple(header, buffer));
+}
+
+static py::object unpickle (py::tuple header, py::object data)
+{
+  if (header.size() < 1 || header[0].cast<int>() != PICKLE_VERSION)
+    throw py::value_error("unsupported bla pickle version");
+  if (header.size() != 5)
+    throw py::value_error("corrupt bla pickle header");
+  std::string kind = header[1].cast<std::string>();
+  if (header[2].cast<std::string>() != nativeDtype() || header[3].cast<std::string>() != "F")
+    throw py::value_error("bla pickle with dtype " + header[2].cast<std::string>()
+                          + " and order " + header[3].cast<std::string>() + " is not supported");
+  py::tuple shape = header[4].cast<py::tuple>();
+
+  Py_buffer view;
+  if (PyObject_GetBuffer(data.ptr(), &view, PyBUF_ANY_CONTIGUOUS) != 0)
+    throw py::error_already_set();
+  std::unique_ptr<Py_buffer, void(*)(Py_buffer*)> release_view(&view, PyBuffer_Release);
+
+  // the number of entries from the shape, checked against the data before allocating
+  size_t n = 1;
+  for (auto dim : shape)
+    {
+      size_t d = dim.cast<size_t>();
+      if (d != 0 && n > std::numeric_limits<size_t>::max() / sizeof(double) / d)
+        throw py::value_error("shape of bla pickle is too large");
+      n *= d;
+    }
+  if (size_t(view.len) != n*sizeof(double))
+    throw py::value_error("size of bla pickle data does not match its shape");
+
+  auto copyFrom = [&view, n] (double * dest)
+  {
+    py::gil_scoped_release release;
+    std::memcpy (dest, view.buf, n*sizeof(double));
+  };
+
+  if (kind == "Vector" && shape.size() == 1)
+    {
+      Vector<double> v(n);
+      copyFrom (v.data());
+      return py::cast(std::move(v));
+    }
+  if (kind == "Matrix" && shape.size() == 2)
+    {
+      Matrix<double> mat(shape[1].cast<size_t>(), shape[0].cast<size_t>());
+      copyFrom (mat.data());
+      return py::cast(std::move(mat));
+    }
+  throw py::value_error("unknown kind " + kind + " in bla pickle");
+}
+
+
+/*
+  Arithmetic runs without the GIL, so Python threads can compute
+  concurrently; parallelism inside an operation still goes through
+  the ASC_HPC pool. Arguments are converted and results wrapped
+  while the GIL is held.
+*/
+
+/*
+  Lazy vector expressions: x + 3*y - z is kept as the terms 1*x, 3*y, -1*z
+  and evaluated by LinearCombination in one pass over memory when it is
+  assigned to a vector, added in place, or on eval(). The terms hold the
+  Python objects they point into, so their memory lives as long as the
+  expression.
+*/
+struct PyVecExpr
+{
+  std::vector<double> coefs;
+  std::vector<PyVectorView> vecs;
+  std::vector<py::object> owners;
+
+  size_t size() const { return vecs[0].size(); }
+
+  // this += c*e, the same vector twice becomes one term
+  void add (double c, const PyVecExpr & e)
+  {
+    if (e.size() != size())
+      throw py::value_error("vector sizes do not match");
+    for (size_t i = 0; i < e.vecs.size(); i++)
+      {
+        size_t j = 0;
+        while (j < vecs.size() &&
+               (vecs[j].data() != e.vecs[i].data() || vecs[j].dist() != e.vecs[i].dist()))
+          j++;
+        if (j < vecs.size())
+          coefs[j] += c*e.coefs[i];
+        else
+          {
+            coefs.push_back(c*e.coefs[i]);
+            vecs.push_back(e.vecs[i]);
+            owners.push_back(e.owners[i]);
+          }
+      }
+  }
+
+  void scale (double c)
+  {
+    for (auto & coef : coefs) coef *= c;
+  }
+};
+
+// a vector, vector view or expression as expression, nothing for other objects
+static std::optional<PyVecExpr> asVecExpr (py::handle h)
+{
+  if (py::isinstance<PyVecExpr>(h))
+    return h.cast<PyVecExpr>();
+  PyVectorView v;
+  if (py::isinstance<PyVectorView>(h))
+    v = h.cast<PyVectorView>();
+  else if (py::isinstance<Vector<double>>(h))
+    v = PyVectorView(h.cast<Vector<double>&>());
+  else
+    return std::nullopt;
+  return PyVecExpr { {1.0}, {v}, {py::reinterpret_borrow<py::object>(h)} };
+}
+
+static bool overlaps (const PyVectorView & a, const PyVectorView & b)
+{
+  if (a.size() == 0 || b.size() == 0) return false;
+  const double * a1 = a.data() + a.dist()*(a.size()-1);
+  const double * b1 = b.data() + b.dist()*(b.size()-1);
+  return a.data() <= b1 && b.data() <= a1;
+}
+
+// y = e, through a temporary if y overlaps a term without being that term
+static void assignVecExpr (PyVectorView y, const PyVecExpr & e)
+{
+  if (y.size() != e.size())
+    throw py::value_error("vector sizes do not match");
+  bool shifted = false;
+  for (auto & x : e.vecs)
+    if (overlaps(x, y) && (x.data() != y.data() || x.dist() != y.dist()))
+      shifted = true;
+
+  py::gil_scoped_release release;
+  if (!shifted)
+    LinearCombination (y, e.vecs.size(), e.coefs.data(), e.vecs.data());
+  else
+    {
+      Vector<double> tmp(y.size());
+      LinearCombination (tmp, e.vecs.size(), e.coefs.data(), e.vecs.data());
+      y = tmp;
+    }
+}
+
+static Vector<double> evalVecExpr (const PyVecExpr & e)
+{
+  Vector<double> v(e.size());
+  py::gil_scoped_release release;
+  LinearCombination (v, e.vecs.size(), e.coefs.data(), e.vecs.data());
+  return v;
+}
+
+static py::object notImplemented()
+{
+  return py::reinterpret_borrow<py::object>(Py_NotImplemented);
+}
+
+// +, - and scalar * of vectors and expressions build expressions
+template <typename TCLS>
+void bindLazyOps (TCLS & cls)
+{
+  cls
+      .def("__add__", [](py::handle self, py::handle other)
+      {
+        auto b = asVecExpr(other);
+        if (!b) return notImplemented();
+        PyVecExpr e = *asVecExpr(self);
+        e.add(1.0, *b);
+        return py::cast(std::move(e));
+      })
+      .def("__sub__", [](py::handle self, py::handle other)
+      {
+        auto b = asVecExpr(other);
+        if (!b) return notImplemented();
+        PyVecExpr e = *asVecExpr(self);
+        e.add(-1.0, *b);
+        return py::cast(std::move(e));
+      })
+      .def("__mul__", [](py::handle self, double scal)
+      {
+        PyVecExpr e = *asVecExpr(self);
+        e.scale(scal);
+        return e;
+      }, py::is_operator())
+      .def("__rmul__", [](py::handle self, double scal)
+      {
+        PyVecExpr e = *asVecExpr(self);
+        e.scale(scal);
+        return e;
+      }, py::is_operator())
+      .def("__neg__", [](py::handle self)
+      {
+        PyVecExpr e = *asVecExpr(self);
+        e.scale(-1.0);
+        return e;
+      })
+    ;
+}
+
+
+// element access and arithmetic shared by Vector and VectorView
+template <typename TVec>
+void bindVectorMethods (py::class_<TVec> & cls)
+{
+  cls
+      .def("__len__", &TVec::size,
            "return size of vector")
       
-      .def("__setitem__", [](Vector<double> & self, int i, double v) {
+      .def("__setitem__", [](TVec & self, int i, double v) {
         if (i < 0) i += self.size();
         if (i < 0 || i >= self.size()) throw py::index_error("vector index out of range");
         self(i) = v;
       })
-      .def("__getitem__", [](Vector<double> & self, int i) { return self(i); })
+      .def("__getitem__", [](TVec & self, int i) {
+        if (i < 0) i += self.size();
+        if (i < 0 || i >= self.size()) throw py::index_error("vector index out of range");
+        return self(i);
+      })
       
-      .def("__setitem__", [](Vector<double> & self, py::slice inds, double val)
+      // x[a:b:c] = scalar, vector or expression
+      .def("__setitem__", [](TVec & self, py::slice inds, py::handle value)
       {
-        size_t start, stop, step, n;
+        py::ssize_t start, stop, step, n;
         if (!inds.compute(self.size(), &start, &stop, &step, &n))
           throw py::error_already_set();
-        self.range(start, stop).slice(0,step) = val;
+        // views have non-negative distances
+        if (step < 0)
+          throw py::value_error("slices with negative step are not supported");
+        PyVectorView y (n, size_t(self.dist())*step, self.data()+start*size_t(self.dist()));
+        if (auto e = asVecExpr(value))
+          assignVecExpr (y, *e);
+        else
+          y = value.cast<double>();
       })
-      
-      .def("__add__", [](Vector<double> & self, Vector<double> & other)
-      { return Vector<double> (self+other); })
 
-      .def("__rmul__", [](Vector<double> & self, double scal)
-      { return Vector<double> (scal*self); })
+      // in-place operations write into the existing memory and return self
+      .def("__iadd__", [](py::object self, py::handle other)
+      {
+        auto b = asVecExpr(other);
+        if (!b) return notImplemented();
+        PyVecExpr e = *asVecExpr(self);
+        e.add(1.0, *b);
+        assignVecExpr (PyVectorView(self.cast<TVec&>()), e);
+        return self;
+      })
+      .def("__isub__", [](py::object self, py::handle other)
+      {
+        auto b = asVecExpr(other);
+        if (!b) return notImplemented();
+        PyVecExpr e = *asVecExpr(self);
+        e.add(-1.0, *b);
+        assignVecExpr (PyVectorView(self.cast<TVec&>()), e);
+        return self;
+      })
+      .def("__imul__", [](py::object self, double scal)
+      {
+        PyVecExpr e = *asVecExpr(self);
+        e.scale(scal);
+        assignVecExpr (PyVectorView(self.cast<TVec&>()), e);
+        return self;
+      })
       
-      .def("__str__", [](const Vector<double> & self)
+      .def("__str__", [](const TVec & self)
       {
         std::stringstream str;
         str << self;
         return str.str();
       })
 
+      .def_buffer([](TVec & self) { return vectorBuffer(self); })
+    ;
+  bindLazyOps (cls);
+}
+
+
+
+PYBIND11_MODULE(bla, m) {
+    m.doc() = "Basic linear algebra module"; // optional module docstring
+    
+    py::class_<PyVecExpr> pyvecexpr (m, "VectorExpression",
+                                     "lazy linear combination of vectors, evaluated in one pass");
+    pyvecexpr
+      .def("eval", &evalVecExpr, "evaluate into a new vector")
+      .def("__len__", &PyVecExpr::size)
+      .def("__getitem__", [](const PyVecExpr & e, int i)
+      {
+        if (i < 0) i += e.size();
+        if (i < 0 || i >= e.size()) throw py::index_error("vector index out of range");
+        double sum = 0;
+        for (size_t t = 0; t < e.vecs.size(); t++)
+          sum += e.coefs[t] * e.vecs[t](i);
+        return sum;
+      })
+      .def("__str__", [](const PyVecExpr & e)
+      {
+        std::stringstream str;
+        str << evalVecExpr(e);
+        return str.str();
+      });
+    bindLazyOps (pyvecexpr);
+
+    py::class_<PyVectorView> pyvectorview (m, "VectorView", py::buffer_protocol(),
+                                           "vector in memory owned by another object");
+    pyvectorview
+      .def(py::init(&wrapVector), py::arg("array"), py::keep_alive<1,2>(),
+           "wrap a writable float64 buffer (e.g. a NumPy array) without copying");
+    bindVectorMethods (pyvectorview);
+
+    py::class_<Vector<double>> pyvector (m, "Vector", py::buffer_protocol());
+    pyvector
+      .def(py::init([](py::buffer b)
+      {
+        py::buffer_info info = b.request();
+        if (info.format != py::format_descriptor<double>::format() || info.ndim != 1)
+          throw py::type_error("expected a one-dimensional buffer of float64");
+        py::gil_scoped_release release;
+        Vector<double> v(info.shape[0]);
+        const char * p = static_cast<const char*>(info.ptr);
+        for (size_t i = 0; i < v.size(); i++)
+          v(i) = *reinterpret_cast<const double*>(p + i*info.strides[0]);
+        return v;
+      }), py::arg("array"), "create vector as a copy of a float64 buffer, any strides")
+      .def(py::init(&evalVecExpr), py::arg("expr"), "evaluate an expression into a new vector")
+      .def(py::init<size_t>(),
+           py::arg("size"), "create vector of given size");
+    bindVectorMethods (pyvector);
+    pyvector
+      .def("__reduce_ex__", [](py::object self, int protocol)
+      {
+        Vector<double> & v = self.cast<Vector<double>&>();
+        return reduceEx (self, protocol, "Vector", py::make_tuple(v.size()), v.data(), v.size());
+      })
      .def(py::pickle(
         [](Vector<double> & self) { // __getstate__
             /* return a tuple that fully encodes the state of the object */
@@ -63,54 +504,140 @@ PYBIND11_MODULE(bla, m) {
           return v;
         }))
     ;
+    py::implicitly_convertible<Vector<double>, PyVectorView>();
 
-  py::class_<Matrix<double>> (m, "Matrix")
-      .def(py::init<size_t, size_t>(),
-           py::arg("width"), py::arg("height"), "create matrix of given dimensions")
+
+  py::class_<PyMatrixView> (m, "MatrixView", py::buffer_protocol(),
+                            "matrix in memory owned by another object")
+      .def(py::init(&wrapMatrix), py::arg("array"), py::keep_alive<1,2>(),
+           "wrap a writable, column major float64 buffer (e.g. a NumPy array) without copying")
       
-      .def("__setitem__", [](Matrix<double> & self, std::tuple<int, int> i, double v) {
+      .def("__setitem__", [](py::handle h, std::tuple<int, int> i, double v) {
+        PyMatrixView & self = writableMatrix(h);
         if (std::get<1>(i) < 0 || std::get<1>(i) >= self.width()) throw py::index_error("Column index out of range");
         if (std::get<0>(i) < 0 || std::get<0>(i) >= self.height()) throw py::index_error("Row index out of range");
         self(std::get<1>(i),std::get<0>(i)) = v;
       })
-      .def("__getitem__", [](Matrix<double> & self, std::tuple<int, int> i, int y) { return self(std::get<1>(i), std::get<0>(i)); })
+      .def("__getitem__", [](PyMatrixView & self, std::tuple<int, int> i) {
+        if (std::get<1>(i) < 0 || std::get<1>(i) >= self.width()) throw py::index_error("Column index out of range");
+        if (std::get<0>(i) < 0 || std::get<0>(i) >= self.height()) throw py::index_error("Row index out of range");
+        return self(std::get<1>(i), std::get<0>(i));
+      })
       
-      .def("__setitem__", [](Matrix<double> & self, std::tuple<py::slice, py::slice> inds, double val)
+      .def("__setitem__", [](py::handle h, std::tuple<py::slice, py::slice> inds, double val)
       {
+        PyMatrixView & self = writableMatrix(h);
         size_t start_y, stop_y, step_y, start_x, stop_x, step_x, n;
         if (!std::get<0>(inds).compute(self.height(), &start_y, &stop_y, &step_y, &n))
           throw py::error_already_set();
-        if (!std::get<1>(inds).compute(self.height(), &start_x, &stop_x, &step_x, &n))
+        if (!std::get<1>(inds).compute(self.width(), &start_x, &stop_x, &step_x, &n))
           throw py::error_already_set();
 
-        for (int x = start_x; x < stop_x; x += step_x) {
-          for (int y = start_y; y < stop_y; y += step_y) {
+        for (size_t x = start_x; x < stop_x; x += step_x) {
+          for (size_t y = start_y; y < stop_y; y += step_y) {
             self(x,y) = val;
           }
         }
       })
 
       
-      .def_property_readonly("shape", [](const Matrix<double>& self) {
+      .def_property_readonly("shape", [](const PyMatrixView& self) {
            return std::tuple(self.height(), self.width());
       })
       
-      .def("__add__", [](Matrix<double> & self, Matrix<double> & other)
-      { return Matrix<double> (self+other); })
+      .def("__add__", [](PyMatrixView & self, PyMatrixView & other)
+      {
+        checkSizes (self, other);
+        py::gil_scoped_release release;
+        return Matrix<double> (self+other);
+      })
 
-      .def("__rmul__", [](Matrix<double> & self, double scal)
-      { return Matrix<double> (scal*self); })
+      .def("__rmul__", [](PyMatrixView & self, double scal)
+      { return Matrix<double> (scal*self); }, py::call_guard<py::gil_scoped_release>())
 
-      .def("__mul__", [](Matrix<double> & self, Matrix<double> & other)
-      { return Matrix<double> (self*other); })
+      .def("__mul__", [](PyMatrixView & self, PyMatrixView & other)
+      {
+        if (self.width() != other.height())
+          throw py::value_error("matrix shapes do not match for the product");
+        py::gil_scoped_release release;
+        return Matrix<double> (self*other);
+      })
+
+      .def("__iadd__", [](py::object self, PyMatrixView & other)
+      {
+        PyMatrixView & mat = writableMatrix(self);
+        checkSizes (mat, other);
+        {
+          py::gil_scoped_release release;
+          mat = mat + other;
+        }
+        return self;
+      })
+      .def("__isub__", [](py::object self, PyMatrixView & other)
+      {
+        PyMatrixView & mat = writableMatrix(self);
+        checkSizes (mat, other);
+        {
+          py::gil_scoped_release release;
+          mat = mat + (-1.0)*other;
+        }
+        return self;
+      })
+      .def("__imul__", [](py::object self, double scal)
+      {
+        PyMatrixView & mat = writableMatrix(self);
+        {
+          py::gil_scoped_release release;
+          mat = scal*mat;
+        }
+        return self;
+      })
       
-      .def("__str__", [](const Matrix<double> & self)
+      .def("__str__", [](const PyMatrixView & self)
       {
         std::stringstream str;
         str << self;
         return str.str();
       })
 
+      .def("save", [](PyMatrixView & self, const std::string & path)
+      { SaveMatrix (path, self); }, py::arg("path"), py::call_guard<py::gil_scoped_release>(),
+           "write the matrix to a matrix file")
+
+      .def_buffer([](PyMatrixView & self) { return matrixBuffer(self); })
+    ;
+
+  // Matrix is a MatrixView owning its memory, it inherits the methods above
+  py::class_<Matrix<double>, PyMatrixView> (m, "Matrix", py::buffer_protocol())
+      .def(py::init([](py::buffer b)
+      {
+        py::buffer_info info = b.request();
+        if (info.format != py::format_descriptor<double>::format() || info.ndim != 2)
+          throw py::type_error("expected a two-dimensional buffer of float64");
+        py::gil_scoped_release release;
+        Matrix<double> mat(info.shape[1], info.shape[0]);
+        const char * p = static_cast<const char*>(info.ptr);
+        for (size_t x = 0; x < mat.width(); x++)
+          for (size_t y = 0; y < mat.height(); y++)
+            mat(x,y) = *reinterpret_cast<const double*>(p + y*info.strides[0] + x*info.strides[1]);
+        return mat;
+      }), py::arg("array"), "create matrix as a copy of a two-dimensional float64 buffer, any ordering")
+      .def(py::init<size_t, size_t>(),
+           py::arg("width"), py::arg("height"), "create matrix of given dimensions")
+
+      .def_static("mmap", [](const std::string & path, bool writable)
+      { return Matrix<double>::mmap(path, writable); }, py::arg("path"), py::arg("writable") = false,
+           "map a column major matrix file into memory, read-only by default")
+
+      .def_buffer([](Matrix<double> & self) { return matrixBuffer(self); })
+
+      .def("__reduce_ex__", [](py::object self, int protocol)
+      {
+        Matrix<double> & mat = self.cast<Matrix<double>&>();
+        return reduceEx (self, protocol, "Matrix", py::make_tuple(mat.height(), mat.width()),
+                         mat.data(), mat.width()*mat.height());
+      })
+
      .def(py::pickle(
         [](Matrix<double> & self) { // __getstate__
             /* return a tuple that fully encodes the state of the object */
@@ -127,4 +654,129 @@ PYBIND11_MODULE(bla, m) {
           return v;
         }))
     ;
+
+  py::class_<MappedMatrix<double>, PyMatrixView> (m, "MappedMatrix", py::buffer_protocol(),
+                                                 "matrix file mapped into memory, see Matrix.mmap")
+      .def_property_readonly("writable", &MappedMatrix<double>::writable)
+      .def_buffer([](MappedMatrix<double> & self) { return matrixBuffer(self, !self.writable()); })
+    ;
+
+  m.def("load_matrix", &LoadMatrix<double>, py::arg("path"),
+        py::call_guard<py::gil_scoped_release>(), "read a matrix file into a new matrix");
+
+  py::class_<MatrixFileWriter<double>> (m, "MatrixFileWriter",
+                                        "writes a matrix file column block by column block")
+      .def(py::init<const std::string &, size_t, size_t>(),
+           py::arg("path"), py::arg("rows"), py::arg("cols"))
+      .def("append", &MatrixFileWriter<double>::append<ColMajor>, py::arg("columns"),
+           py::call_guard<py::gil_scoped_release>(), "write the next columns")
+      .def("close", &MatrixFileWriter<double>::close,
+           "finish the file, raises if columns are missing")
+      .def_property_readonly("columns_written", &MatrixFileWriter<double>::columnsWritten)
+      .def("__enter__", [](py::object self) { return self; })
+      .def("__exit__", [](MatrixFileWriter<double> & self, py::object type, py::args)
+      {
+        // after an exception inside the with-block, do not complain about missing columns
+        if (type.is_none())
+          self.close();
+      })
+    ;
+
+  m.def("_unpickle", &unpickle, py::arg("header"), py::arg("data"),
+        "rebuild a Vector or Matrix from its pickled header and data");
+
+  py::class_<PyTaskManager> (m, "TaskManager",
+                             "keeps the worker threads alive inside a with-block")
+      .def(py::init([](int num_threads) { return PyTaskManager{num_threads, nullptr}; }),
+           py::arg("num_threads") = 0, "number of threads, 0 for the default")
+      .def("__enter__", [](PyTaskManager & self) -> PyTaskManager &
+      {
+        if (!self.tm)
+          self.tm = std::make_unique<ASC_HPC::TaskManager>(self.num_threads);
+        return self;
+      }, py::return_value_policy::reference)
+      .def("__exit__", [](PyTaskManager & self, py::args) { self.tm.reset(); })
+      .def_property_readonly("num_threads", [](const PyTaskManager & self)
+      { return self.tm ? self.tm->numThreads() : ASC_HPC::NumThreads(); })
+    ;
+
+  // operations writing into existing storage, they return the result object
+
+  m.def("gemm", [](PyMatrixView & A, PyMatrixView & B, py::object out, double alpha, double beta)
+  {
+    if (A.width() != B.height())
+      throw py::value_error("matrix shapes do not match for the product");
+    if (out.is_none())
+      {
+        Matrix<double> C(B.width(), A.height());
+        {
+          py::gil_scoped_release release;
+          C = alpha*(A*B);
+        }
+        return py::cast(std::move(C));
+      }
+    PyMatrixView & C = writableMatrix(out);
+    if (C.height() != A.height() || C.width() != B.width())
+      throw py::value_error("shape of out does not match the product");
+    {
+      py::gil_scoped_release release;
+      C = beta*C + alpha*(A*B);     // one gemm pass, C is not read if beta = 0
+    }
+    return out;
+  }, py::arg("A"), py::arg("B"), py::arg("out") = py::none(),
+     py::arg("alpha") = 1.0, py::arg("beta") = 0.0,
+     "out = alpha*A*B + beta*out, or a new matrix alpha*A*B without out");
+
+  m.def("axpy", [](double a, const PyVectorView & x, py::object y)
+  {
+    PyVectorView yv = y.cast<PyVectorView>();
+    checkSizes (x, yv);
+    {
+      py::gil_scoped_release release;
+      yv = yv + a*x;
+    }
+    return y;
+  }, py::arg("a"), py::arg("x"), py::arg("y"), "y += a*x");
+
+  // reductions, with the mode set by set_deterministic_reductions
+  m.def("dot", [](const PyVectorView & x, const PyVectorView & y)
+  {
+    checkSizes (x, y);
+    py::gil_scoped_release release;
+    return dot (x, y);
+  }, py::arg("x"), py::arg("y"), "inner product of x and y");
+  m.def("norm", [](const PyVectorView & x)
+  {
+    py::gil_scoped_release release;
+    return Norm (x);
+  }, py::arg("x"), "Euclidean norm, without overflow or underflow");
+  m.def("max_abs", [](const PyVectorView & x)
+  {
+    py::gil_scoped_release release;
+    return MaxAbs (x);
+  }, py::arg("x"), "largest absolute value of the entries");
+  m.def("set_deterministic_reductions", [](bool deterministic, bool compensated)
+  {
+    SetReductionMode (compensated ? CompensatedReduction
+                      : deterministic ? DeterministicReduction : FastReduction);
+  }, py::arg("deterministic"), py::arg("compensated") = false,
+     "reductions give the same bits for any number of threads if True,\n"
+     "compensated sums also add up their rounding errors");
+
+  m.def("num_threads", &ASC_HPC::NumThreads,
+        "number of threads used for parallel operations");
+  m.def("set_num_threads", &ASC_HPC::SetNumThreads, py::arg("num"),
+        "set the number of threads of the default pool, 0 for the default");
+  m.def("set_spin_time", &ASC_HPC::SetSpinTime, py::arg("microseconds"),
+        "time idle threads spin and yield before they sleep");
+  m.def("worker_statistics", []()
+  {
+    auto stat = ASC_HPC::GetWorkerStatistics();
+    py::dict d;
+    d["sleeps"] = stat.sleeps;
+    d["wakeups"] = stat.wakeups;
+    d["spin_time"] = stat.spin_time;
+    return d;
+  }, "counters of the idle back-off of the worker threads");
+  m.def("reset_worker_statistics", &ASC_HPC::ResetWorkerStatistics);
 }
@@ -0,0 +1,385 @@
+#ifndef FILE_GEMM
+#define FILE_GEMM
+
+#include <algorithm>
+#include <new>
+#include <vector>
+
+#include "simd_functions.hpp"
+#include "taskmanager.hpp"
+
+/*
+  Matrix-matrix multiplication C = beta*D + alpha*A*B on raw memory,
+  where D is C itself or another matrix of the same shape.
+
+  A matrix is given by a pointer to its (0,0) entry, the distance between
+  consecutive rows (rd) and the distance between consecutive columns (cd),
+  so column-major, row-major and transposed views are all handled by the
+  same code.
+
+  gemm follows the usual packed scheme: B is split into KC x NC blocks
+  (kept in L3) and packed into NR-wide panels, A is split into MC x KC
+  blocks (kept in L2) and packed into MR-high panels, and the MR x NR
+  register kernel runs over one A panel and one B panel (kept in L1).
+*/
+
+namespace ASC_bla
+{
+
+  // register block of the matrix-matrix kernel, H rows times W columns.
+  // H is a multiple of the SIMD width, H/SIMD_WIDTH*W accumulators
+  // plus the A column and the broadcast B value fill the register file
+  template <typename T>
+  struct MatMatKernelSize
+  {
+#if defined(ASC_SIMD_AVX512)
+    static constexpr size_t H = 3*SIMD_WIDTH<T>;
+    static constexpr size_t W = 8;
+#elif defined(ASC_SIMD_AVX)
+    static constexpr size_t H = 3*SIMD_WIDTH<T>;
+    static constexpr size_t W = 4;
+#elif defined(ASC_SIMD_NEON)
+    static constexpr size_t H = 4*SIMD_WIDTH<T>;
+    static constexpr size_t W = 6;
+#else
+    static constexpr size_t H = 4;
+    static constexpr size_t W = 4;
+#endif
+  };
+
+  // cache blocks of gemm: an NR x KC panel of B fits into L1,
+  // an MC x KC block of A into L2, and a KC x NC block of B into L3
+  template <typename T>
+  struct GemmBlockSize
+  {
+    static constexpr size_t MR = MatMatKernelSize<T>::H;
+    static constexpr size_t NR = MatMatKernelSize<T>::W;
+#if defined(ASC_SIMD_AVX512)
+    static constexpr size_t KC = 2048 / sizeof(T);
+    static constexpr size_t MC = 8*MR;
+    static constexpr size_t NC = 512*NR;
+#elif defined(ASC_SIMD_AVX)
+    static constexpr size_t KC = 2048 / sizeof(T);
+    static constexpr size_t MC = 8*MR;
+    static constexpr size_t NC = 512*NR;
+#elif defined(ASC_SIMD_NEON)
+    static constexpr size_t KC = 4096 / sizeof(T);
+    static constexpr size_t MC = 32*MR;
+    static constexpr size_t NC = 512*NR;
+#else
+    static constexpr size_t KC = 2048 / sizeof(T);
+    static constexpr size_t MC = 16*MR;
+    static constexpr size_t NC = 256*NR;
+#endif
+    // B panels handled by one parallel task
+    static constexpr size_t PANELS_PER_TASK = 16;
+  };
+
+
+  // C(0:H, 0:W) = beta*D + alpha * A(0:H, 0:k) * B(0:k, 0:W)
+  // column l of A is at pa + l*da, B(l,j) at pb[l*dbr + j*dbc],
+  // column j of C at pc + j*dc, and column j of D at pd + j*dd.
+  // If MASKED, only rows where mask is set are read from A and D, and written to C.
+  template <size_t H, size_t W, bool MASKED, typename T>
+  inline void AddMatMatKernel (size_t k, const T * pa, size_t da,
+                               const T * pb, size_t dbr, size_t dbc,
+                               const T * pd, size_t dd, T * pc, size_t dc,
+                               T alpha, T beta, SIMD<simd_mask_t<T>,H> mask)
+  {
+    auto load = [mask] (const T * p)
+    {
+      if constexpr (MASKED) return SIMD<T,H>(p, mask);
+      else return SIMD<T,H>(p);
+    };
+
+    SIMD<T,H> sum[W];
+    Unroll<W> ([&](auto j) { sum[j] = SIMD<T,H>(T(0)); });
+
+    for (size_t l = 0; l < k; l++, pa += da, pb += dbr)
+      {
+        SIMD<T,H> a = load(pa);
+        Unroll<W> ([&](auto j) { sum[j] = FMA(a, SIMD<T,H>(pb[j*dbc]), sum[j]); });
+      }
+
+    Unroll<W> ([&](auto j)
+    {
+      SIMD<T,H> c = SIMD<T,H>(alpha) * sum[j];
+      if (beta != T(0))
+        c = FMA(SIMD<T,H>(beta), load(pd+j*dd), c);
+      if constexpr (MASKED)
+        c.store(pc+j*dc, mask);
+      else
+        c.store(pc+j*dc);
+    });
+  }
+
+  // kernel for w <= W columns, leftover columns get a narrower kernel
+  template <size_t H, size_t W, bool MASKED, typename T>
+  inline void AddMatMatKernelCols (size_t w, size_t k, const T * pa, size_t da,
+                                   const T * pb, size_t dbr, size_t dbc,
+                                   const T * pd, size_t dd, T * pc, size_t dc,
+                                   T alpha, T beta, SIMD<simd_mask_t<T>,H> mask)
+  {
+    if constexpr (W > 0)
+      {
+        if (w == W)
+          AddMatMatKernel<H,W,MASKED> (k, pa, da, pb, dbr, dbc, pd, dd, pc, dc, alpha, beta, mask);
+        else
+          AddMatMatKernelCols<H,W-1,MASKED> (w, k, pa, da, pb, dbr, dbc, pd, dd, pc, dc, alpha, beta, mask);
+      }
+  }
+
+  // C(0:h, 0:w) with H x W kernels, A must have contiguous columns
+  template <size_t H, size_t W, typename T>
+  void AddMatMatBlock (size_t h, size_t w, size_t k,
+                       const T * pa, size_t da, size_t dah,
+                       const T * pb, size_t dbr, size_t dbc, size_t dbw,
+                       const T * pd, size_t dd, T * pc, size_t dc, T alpha, T beta)
+  {
+    // dah .. distance between H-blocks of A, dbw .. distance between W-blocks of B
+    auto mask = SIMD<simd_mask_t<T>,H>::mask_first(h % H);
+    for (size_t j = 0; j < w; j += W, pb += dbw, pc += W*dc, pd += W*dd)
+      {
+        size_t wj = std::min(W, w-j);
+        size_t i = 0;
+        const T * pai = pa;
+        for ( ; i+H <= h; i += H, pai += dah)
+          AddMatMatKernelCols<H,W,false> (wj, k, pai, da, pb, dbr, dbc, pd+i, dd, pc+i, dc, alpha, beta, mask);
+        // leftover rows
+        if (i < h)
+          AddMatMatKernelCols<H,W,true> (wj, k, pai, da, pb, dbr, dbc, pd+i, dd, pc+i, dc, alpha, beta, mask);
+      }
+  }
+
+
+  // thread-local, 64-byte aligned scratch memory. Buffers are reused
+  // between calls, nested calls on one thread get their own buffer.
+  template <typename T>
+  class ScratchMemory
+  {
+    struct Buffer
+    {
+      void * ptr = nullptr;
+      size_t bytes = 0;
+      Buffer() = default;
+      Buffer(Buffer && b) : ptr(b.ptr), bytes(b.bytes) { b.ptr = nullptr; }
+      ~Buffer() { if (ptr) ::operator delete[](ptr, std::align_val_t(64)); }
+    };
+    static std::vector<Buffer> & Stack()
+    {
+      thread_local std::vector<Buffer> stack;
+      return stack;
+    }
+    static size_t & Depth()
+    {
+      thread_local size_t depth = 0;
+      return depth;
+    }
+    T * m_data;
+  public:
+    ScratchMemory (size_t size)
+    {
+      auto & stack = Stack();
+      size_t level = Depth()++;
+      if (level == stack.size())
+        stack.emplace_back();
+      Buffer & buf = stack[level];
+      size_t bytes = size*sizeof(T);
+      if (buf.bytes < bytes)
+        {
+          if (buf.ptr) ::operator delete[](buf.ptr, std::align_val_t(64));
+          buf.ptr = ::operator new[](bytes, std::align_val_t(64));
+          buf.bytes = bytes;
+        }
+      m_data = static_cast<T*>(buf.ptr);
+    }
+    ScratchMemory (const ScratchMemory &) = delete;
+    ~ScratchMemory () { Depth()--; }
+    T * data() const { return m_data; }
+  };
+
+
+  // A(0:h, 0:k) into panels of MR rows, zero-padded: panel p, column l at pack + p*MR*k + l*MR
+  template <size_t MR, typename T>
+  void PackA (size_t h, size_t k, const T * a, size_t rd, size_t cd, T * pack)
+  {
+    for (size_t i = 0; i < h; i += MR, pack += MR*k)
+      {
+        size_t hi = std::min(MR, h-i);
+        const T * ai = a + i*rd;
+        if (rd == 1)
+          {
+            auto mask = SIMD<simd_mask_t<T>,MR>::mask_first(hi);
+            for (size_t l = 0; l < k; l++)
+              SIMD<T,MR>(ai+l*cd, mask).store(pack+l*MR);
+          }
+        else
+          for (size_t l = 0; l < k; l++)
+            for (size_t r = 0; r < MR; r++)
+              pack[l*MR+r] = (r < hi) ? ai[r*rd+l*cd] : T(0);
+      }
+  }
+
+  // B(0:k, 0:w) into panels of NR columns, zero-padded: panel p, row l at pack + p*NR*k + l*NR
+  template <size_t NR, typename T>
+  void PackB (size_t k, size_t w, const T * b, size_t rd, size_t cd, T * pack)
+  {
+    for (size_t j = 0; j < w; j += NR, pack += NR*k)
+      {
+        size_t wj = std::min(NR, w-j);
+        const T * bj = b + j*cd;
+        for (size_t l = 0; l < k; l++)
+          for (size_t c = 0; c < NR; c++)
+            pack[l*NR+c] = (c < wj) ? bj[l*rd+c*cd] : T(0);
+      }
+  }
+
+
+  // C = beta*D, beta = 0 does not read D
+  template <typename T>
+  void scaleMatrix (size_t h, size_t w, T beta, const T * d, size_t drd, size_t dcd,
+                    T * c, size_t crd, size_t ccd)
+  {
+    if (beta == T(1) && d == c && drd == crd && dcd == ccd) return;
+    for (size_t j = 0; j < w; j++)
+      for (size_t i = 0; i < h; i++)
+        c[i*crd+j*ccd] = (beta == T(0)) ? T(0) : beta*d[i*drd+j*dcd];
+  }
+
+
+  // C = beta*D + alpha*A*B on one core without packing, for small matrices.
+  // A, D and C must have contiguous columns (rd == 1).
+  template <typename T>
+  void gemmUnpacked (size_t h, size_t w, size_t k, T alpha,
+                     const T * a, size_t acd, const T * b, size_t brd, size_t bcd,
+                     T beta, const T * d, size_t dcd, T * c, size_t ccd)
+  {
+    constexpr size_t H = MatMatKernelSize<T>::H;
+    constexpr size_t W = MatMatKernelSize<T>::W;
+    AddMatMatBlock<H,W> (h, w, k, a, acd, H, b, brd, bcd, W*bcd, d, dcd, c, ccd, alpha, beta);
+  }
+
+
+  // C = beta*D + alpha*A*B, A is h x k, B is k x w, C and D are h x w.
+  // rd/cd are the distances between rows and columns of each matrix.
+  // D is read before C is written entry by entry, so D may be C itself.
+  // Runs in parallel on the ASC_HPC workers.
+  template <typename T>
+  void gemm (size_t h, size_t w, size_t k, T alpha,
+             const T * a, size_t ard, size_t acd,
+             const T * b, size_t brd, size_t bcd,
+             T beta, const T * d, size_t drd, size_t dcd,
+             T * c, size_t crd, size_t ccd)
+  {
+    typedef GemmBlockSize<T> BS;
+    constexpr size_t MR = BS::MR;
+    constexpr size_t NR = BS::NR;
+
+    if (h == 0 || w == 0) return;
+
+    if (crd != 1 && ccd == 1)
+      {
+        // row-major C: compute C^T = B^T A^T
+        gemm (w, h, k, alpha, b, bcd, brd, a, acd, ard, beta, d, dcd, drd, c, ccd, crd);
+        return;
+      }
+
+    if (crd == 1 && drd != 1 && beta != T(0))
+      {
+        // D without contiguous columns: C = beta*D first
+        scaleMatrix (h, w, beta, d, drd, dcd, c, crd, ccd);
+        beta = T(1);
+        d = c; drd = crd; dcd = ccd;
+      }
+
+    if (crd != 1)
+      {
+        // no contiguous direction in C
+        for (size_t j = 0; j < w; j++)
+          for (size_t i = 0; i < h; i++)
+            {
+              T sum = T(0);
+              for (size_t l = 0; l < k; l++)
+                sum += a[i*ard+l*acd] * b[l*brd+j*bcd];
+              c[i*crd+j*ccd] = alpha*sum + ((beta == T(0)) ? T(0) : beta*d[i*drd+j*dcd]);
+            }
+        return;
+      }
+
+    if (k == 0 || alpha == T(0))
+      {
+        scaleMatrix (h, w, beta, d, drd, dcd, c, crd, ccd);
+        return;
+      }
+
+    // everything fits into cache: no packing, no threads
+    if (ard == 1 && h*w*k <= 64*64*64)
+      {
+        gemmUnpacked (h, w, k, alpha, a, acd, b, brd, bcd, beta, d, dcd, c, ccd);
+        return;
+      }
+
+    size_t mblocks = (h+BS::MC-1) / BS::MC;
+
+    for (size_t jc = 0; jc < w; jc += BS::NC)
+      {
+        size_t nc = std::min(BS::NC, w-jc);
+        size_t npanels = (nc+NR-1) / NR;
+        size_t nchunks = (npanels+BS::PANELS_PER_TASK-1) / BS::PANELS_PER_TASK;
+
+        for (size_t pc = 0; pc < k; pc += BS::KC)
+          {
+            size_t kc = std::min(BS::KC, k-pc);
+            // the first k-block adds beta*D, the others accumulate into C
+            T betapc = (pc == 0) ? beta : T(1);
+            const T * dpc = (pc == 0) ? d : c;
+            size_t dpcd = (pc == 0) ? dcd : ccd;
+
+            ScratchMemory<T> memB(npanels*NR*kc);
+            T * packB = memB.data();
+            const T * bpc = b + pc*brd + jc*bcd;
+
+            ASC_HPC::RunParallel (nchunks, [=] (int nr, int size)
+            {
+              size_t first = nr*BS::PANELS_PER_TASK*NR;
+              size_t next = std::min(nc, first+BS::PANELS_PER_TASK*NR);
+              PackB<NR> (kc, next-first, bpc+first*bcd, brd, bcd, packB+first*kc);
+            });
+
+            // one task: one MC block of A times PANELS_PER_TASK panels of B
+            ASC_HPC::RunParallel (mblocks*nchunks, [=] (int nr, int size)
+            {
+              size_t ib = nr % mblocks;
+              size_t jb = nr / mblocks;
+              size_t ic = ib*BS::MC;
+              size_t mc = std::min(BS::MC, h-ic);
+
+              ScratchMemory<T> memA((mc+MR-1)/MR*MR*kc);
+              T * packA = memA.data();
+              PackA<MR> (mc, kc, a+ic*ard+pc*acd, ard, acd, packA);
+
+              size_t first = jb*BS::PANELS_PER_TASK*NR;
+              size_t next = std::min(nc, first+BS::PANELS_PER_TASK*NR);
+              AddMatMatBlock<MR,NR> (mc, next-first, kc,
+                                     packA, MR, MR*kc,
+                                     packB+first*kc, NR, 1, NR*kc,
+                                     dpc+ic+(jc+first)*dpcd, dpcd,
+                                     c+ic+(jc+first)*ccd, ccd, alpha, betapc);
+            });
+          }
+      }
+  }
+
+  // C = beta*C + alpha*A*B
+  template <typename T>
+  void gemm (size_t h, size_t w, size_t k, T alpha,
+             const T * a, size_t ard, size_t acd,
+             const T * b, size_t brd, size_t bcd,
+             T beta, T * c, size_t crd, size_t ccd)
+  {
+    gemm (h, w, k, alpha, a, ard, acd, b, brd, bcd, beta, c, crd, ccd, c, crd, ccd);
+  }
+
+}
+
+#endif
@@ -3,6 +3,12 @@
 
 #include <iostream>
 #include <string>
+#include <vector>
+#include <stdexcept>
+#include <cassert>
+#include <cstdlib>
+#include <limits>
+#include <type_traits>
 
 #include "vector.hpp"
 #include "matrix.hpp"
@@ -34,64 +40,596 @@ extern "C" {
 namespace ASC_bla
 {
 
+  /*
+    BLAS-1/2/3 for float, double, std::complex<float> and
+    std::complex<double> on vector and matrix views:
 
-  // BLAS-1 functions:
+      blas::scal, axpy, dot, nrm2           (level 1)
+      blas::gemv, ger, trsv                 (level 2)
+      blas::gemm, syrk, trsm                (level 3)
 
-  /*
-    int daxpy_(integer *n, doublereal *da, doublereal *dx, 
-    integer *incx, doublereal *dy, integer *incy);
+    Every call estimates its work (n, m*n or m*n*k) and calls the linked
+    BLAS from BlasThreshold() on, below that the library's own kernels
+    (gemm and the reductions for float and double, plain loops else),
+    which do not pay for the call overhead. SetBlasThreshold(0) sends
+    everything to BLAS, SetBlasThreshold(SIZE_MAX) nothing. The default
+    is taken from the environment variable ASC_BLAS_THRESHOLD.
+
+    A matrix view goes to BLAS as it is ('N') if its rows are contiguous,
+    or as its transpose ('T') if its columns are, with the distance of the
+    other direction as leading dimension, so windows, row major and
+    transposed views are not copied. Views without a contiguous direction
+    (every other row or column) use the library kernels.
+
+    dot and nrm2 call ddot_, dnrm2_ and dznrm2_ only: clapack.h declares
+    the float and complex variants with f2c return conventions, which
+    do not match gfortran compiled BLAS libraries.
   */
-  // y += alpha x
+
+  namespace blas_detail
+  {
+    inline size_t threshold = [] ()
+    {
+      if (const char * env = std::getenv("ASC_BLAS_THRESHOLD"))
+        return size_t(std::strtoull(env, nullptr, 10));
+      // from here on the library gemm packs and runs in parallel as well
+      return size_t(64*64*64);
+    } ();
+
+    template <typename T>
+    constexpr bool is_blas_type = std::is_same_v<T,float> || std::is_same_v<T,double>
+      || std::is_same_v<T,singlecomplex> || std::is_same_v<T,doublecomplex>;
+
+    template <typename T>
+    constexpr bool is_real = std::is_same_v<T,float> || std::is_same_v<T,double>;
+
+    // non-deduced scalar type, so blas::gemm(1.0, A, B, 0.0, C) works for float matrices
+    template <typename T>
+    using scalar_t = typename std::common_type<T>::type;
+
+    inline bool fits (size_t n) { return n <= size_t(std::numeric_limits<integer>::max()); }
+
+    inline bool useBlas (size_t work) { return work >= threshold; }
+
+    /*
+      A matrix view as BLAS sees it: data, leading dimension, and
+      trans = 'N' if the stored matrix is the view itself (contiguous rows),
+      'T' if it is its transpose (contiguous columns). Strides of a
+      direction of length <= 1 do not matter.
+    */
+    template <typename T>
+    struct BlasMatrix
+    {
+      T * data;
+      char trans;
+      integer ld;
+      bool ok;
+    };
+
+    template <typename T, ORDERING ORD>
+    BlasMatrix<T> blasMatrix (MatrixView<T,ORD> a)
+    {
+      size_t h = a.height(), w = a.width();
+      size_t rd = h > 1 ? a.row_dist() : 1;
+      size_t cd = w > 1 ? a.col_dist() : 1;
+      BlasMatrix<T> m { (h && w) ? &a(0,0) : a.data(), 'N', 1, false };
+      size_t ld = 1;
+      if (rd == 1)
+        {
+          ld = w > 1 ? cd : std::max<size_t>(h, 1);
+          m.ok = ld >= h;
+        }
+      else if (cd == 1)
+        {
+          m.trans = 'T';
+          ld = h > 1 ? rd : std::max<size_t>(w, 1);
+          m.ok = ld >= w;
+        }
+      m.ok = m.ok && fits(h) && fits(w) && fits(ld);
+      m.ld = integer(ld);
+      return m;
+    }
+
+    inline char flip (char c)
+    {
+      switch (c)
+        {
+        case 'N': return 'T';
+        case 'T': return 'N';
+        case 'L': return 'U';
+        default: return 'L';
+        }
+    }
+
+    template <typename TV>
+    bool blasVector (const TV & x)
+    {
+      return fits(x.size()) && fits(size_t(x.dist()));
+    }
+
+
+    // overloads of the Fortran routines by type
+
+    inline void xscal (integer n, float a, float * x, integer incx) { sscal_(&n, &a, x, &incx); }
+    inline void xscal (integer n, double a, double * x, integer incx) { dscal_(&n, &a, x, &incx); }
+    inline void xscal (integer n, singlecomplex a, singlecomplex * x, integer incx) { cscal_(&n, &a, x, &incx); }
+    inline void xscal (integer n, doublecomplex a, doublecomplex * x, integer incx) { zscal_(&n, &a, x, &incx); }
+
+    inline void xaxpy (integer n, float a, float * x, integer incx, float * y, integer incy)
+    { saxpy_(&n, &a, x, &incx, y, &incy); }
+    inline void xaxpy (integer n, double a, double * x, integer incx, double * y, integer incy)
+    { daxpy_(&n, &a, x, &incx, y, &incy); }
+    inline void xaxpy (integer n, singlecomplex a, singlecomplex * x, integer incx, singlecomplex * y, integer incy)
+    { caxpy_(&n, &a, x, &incx, y, &incy); }
+    inline void xaxpy (integer n, doublecomplex a, doublecomplex * x, integer incx, doublecomplex * y, integer incy)
+    { zaxpy_(&n, &a, x, &incx, y, &incy); }
+
+#define ASC_BLAS_GEMV(T, F)                                             \
+    inline void xgemv (char trans, integer m, integer n, T alpha, T * a, integer lda, \
+                       T * x, integer incx, T beta, T * y, integer incy) \
+    { F(&trans, &m, &n, &alpha, a, &lda, x, &incx, &beta, y, &incy); }
+    ASC_BLAS_GEMV(float, sgemv_)
+    ASC_BLAS_GEMV(double, dgemv_)
+    ASC_BLAS_GEMV(singlecomplex, cgemv_)
+    ASC_BLAS_GEMV(doublecomplex, zgemv_)
+#undef ASC_BLAS_GEMV
+
+    // complex: the unconjugated geru, A += alpha x y^T
+#define ASC_BLAS_GER(T, F)                                              \
+    inline void xger (integer m, integer n, T alpha, T * x, integer incx, \
+                      T * y, integer incy, T * a, integer lda)          \
+    { F(&m, &n, &alpha, x, &incx, y, &incy, a, &lda); }
+    ASC_BLAS_GER(float, sger_)
+    ASC_BLAS_GER(double, dger_)
+    ASC_BLAS_GER(singlecomplex, cgeru_)
+    ASC_BLAS_GER(doublecomplex, zgeru_)
+#undef ASC_BLAS_GER
+
+#define ASC_BLAS_TRSV(T, F)                                             \
+    inline void xtrsv (char uplo, char trans, char diag, integer n,     \
+                       T * a, integer lda, T * x, integer incx)         \
+    { F(&uplo, &trans, &diag, &n, a, &lda, x, &incx); }
+    ASC_BLAS_TRSV(float, strsv_)
+    ASC_BLAS_TRSV(double, dtrsv_)
+    ASC_BLAS_TRSV(singlecomplex, ctrsv_)
+    ASC_BLAS_TRSV(doublecomplex, ztrsv_)
+#undef ASC_BLAS_TRSV
+
+#define ASC_BLAS_GEMM(T, F)                                             \
+    inline void xgemm (char transa, char transb, integer m, integer n, integer k, \
+                       T alpha, T * a, integer lda, T * b, integer ldb, \
+                       T beta, T * c, integer ldc)                      \
+    { F(&transa, &transb, &m, &n, &k, &alpha, a, &lda, b, &ldb, &beta, c, &ldc); }
+    ASC_BLAS_GEMM(float, sgemm_)
+    ASC_BLAS_GEMM(double, dgemm_)
+    ASC_BLAS_GEMM(singlecomplex, cgemm_)
+    ASC_BLAS_GEMM(doublecomplex, zgemm_)
+#undef ASC_BLAS_GEMM
+
+#define ASC_BLAS_SYRK(T, F)                                             \
+    inline void xsyrk (char uplo, char trans, integer n, integer k, T alpha, \
+                       T * a, integer lda, T beta, T * c, integer ldc)  \
+    { F(&uplo, &trans, &n, &k, &alpha, a, &lda, &beta, c, &ldc); }
+    ASC_BLAS_SYRK(float, ssyrk_)
+    ASC_BLAS_SYRK(double, dsyrk_)
+    ASC_BLAS_SYRK(singlecomplex, csyrk_)
+    ASC_BLAS_SYRK(doublecomplex, zsyrk_)
+#undef ASC_BLAS_SYRK
+
+#define ASC_BLAS_TRSM(T, F)                                             \
+    inline void xtrsm (char side, char uplo, char transa, char diag,   \
+                       integer m, integer n, T alpha, T * a, integer lda, \
+                       T * b, integer ldb)                              \
+    { F(&side, &uplo, &transa, &diag, &m, &n, &alpha, a, &lda, b, &ldb); }
+    ASC_BLAS_TRSM(float, strsm_)
+    ASC_BLAS_TRSM(double, dtrsm_)
+    ASC_BLAS_TRSM(singlecomplex, ctrsm_)
+    ASC_BLAS_TRSM(doublecomplex, ztrsm_)
+#undef ASC_BLAS_TRSM
+
+
+    // library kernels, for small sizes, other types and views BLAS cannot take
+
+    template <typename T, ORDERING ORD>
+    void scaleLib (T beta, MatrixView<T,ORD> c)
+    {
+      for (size_t j = 0; j < c.width(); j++)
+        for (size_t i = 0; i < c.height(); i++)
+          c(j,i) = (beta == T(0)) ? T(0) : beta*c(j,i);
+    }
+
+    template <typename T, ORDERING ORDA, ORDERING ORDB, ORDERING ORDC>
+    void gemmLib (T alpha, MatrixView<T,ORDA> a, MatrixView<T,ORDB> b, T beta, MatrixView<T,ORDC> c)
+    {
+      size_t h = c.height(), w = c.width(), k = a.width();
+      if (h == 0 || w == 0) return;
+      if constexpr (is_real<T>)
+        {
+          if (k == 0)
+            scaleLib (beta, c);
+          else
+            ASC_bla::gemm (h, w, k, alpha, &a(0,0), a.row_dist(), a.col_dist(),
+                           &b(0,0), b.row_dist(), b.col_dist(),
+                           beta, &c(0,0), c.row_dist(), c.col_dist());
+        }
+      else
+        {
+          scaleLib (beta, c);
+          for (size_t j = 0; j < w; j++)
+            for (size_t l = 0; l < k; l++)
+              {
+                T t = alpha * b(j,l);
+                for (size_t i = 0; i < h; i++)
+                  c(j,i) += a(l,i) * t;
+              }
+        }
+    }
+
+    template <typename T, ORDERING ORD, typename TX, typename TY>
+    void gemvLib (T alpha, MatrixView<T,ORD> a, VectorView<T,TX> x, T beta, VectorView<T,TY> y)
+    {
+      for (size_t i = 0; i < y.size(); i++)
+        y(i) = (beta == T(0)) ? T(0) : beta*y(i);
+      if (a.row_dist() == 1)
+        // axpy with the columns
+        for (size_t j = 0; j < a.width(); j++)
+          {
+            T t = alpha * x(j);
+            for (size_t i = 0; i < a.height(); i++)
+              y(i) += a(j,i) * t;
+          }
+      else
+        // dot products with the rows
+        for (size_t i = 0; i < a.height(); i++)
+          {
+            T sum = T(0);
+            for (size_t j = 0; j < a.width(); j++)
+              sum += a(j,i) * x(j);
+            y(i) += alpha * sum;
+          }
+    }
+
+    template <typename T, ORDERING ORD, typename TX, typename TY>
+    void gerLib (T alpha, VectorView<T,TX> x, VectorView<T,TY> y, MatrixView<T,ORD> a)
+    {
+      if (a.row_dist() == 1)
+        for (size_t j = 0; j < a.width(); j++)
+          {
+            T t = alpha * y(j);
+            for (size_t i = 0; i < a.height(); i++)
+              a(j,i) += x(i) * t;
+          }
+      else
+        for (size_t i = 0; i < a.height(); i++)
+          {
+            T t = alpha * x(i);
+            for (size_t j = 0; j < a.width(); j++)
+              a(j,i) += t * y(j);
+          }
+    }
+
+    // x = A^{-1} x for triangular A, x given by pointer and distance
+    template <typename T, ORDERING ORD>
+    void trsvLib (bool lower, bool unit, MatrixView<T,ORD> a, T * x, size_t incx)
+    {
+      size_t n = a.height();
+      for (size_t s = 0; s < n; s++)
+        {
+          size_t i = lower ? s : n-1-s;
+          T sum = x[i*incx];
+          if (lower)
+            for (size_t j = 0; j < i; j++)
+              sum -= a(j,i) * x[j*incx];
+          else
+            for (size_t j = i+1; j < n; j++)
+              sum -= a(j,i) * x[j*incx];
+          x[i*incx] = unit ? sum : sum / a(i,i);
+        }
+    }
+
+    template <typename T, ORDERING ORDA, ORDERING ORDC>
+    void syrkLib (bool lower, T alpha, MatrixView<T,ORDA> a, T beta, MatrixView<T,ORDC> c)
+    {
+      size_t n = c.height(), k = a.width();
+      for (size_t j = 0; j < n; j++)
+        for (size_t i = lower ? j : 0; i < (lower ? n : j+1); i++)
+          {
+            T sum = T(0);
+            for (size_t l = 0; l < k; l++)
+              sum += a(l,i) * a(l,j);
+            c(j,i) = alpha*sum + ((beta == T(0)) ? T(0) : beta*c(j,i));
+          }
+    }
+
+
+    // the BLAS calls, false if a view has no BLAS layout
+
+    template <typename T, ORDERING ORDA, ORDERING ORDB, ORDERING ORDC>
+    bool gemmBlas (T alpha, MatrixView<T,ORDA> a, MatrixView<T,ORDB> b, T beta, MatrixView<T,ORDC> c)
+    {
+      auto mc = blasMatrix(c);
+      if (!mc.ok) return false;
+      // C stored transposed: C^T = B^T A^T
+      if (mc.trans == 'T')
+        return gemmBlas (alpha, Trans(b), Trans(a), beta, Trans(c));
+
+      auto ma = blasMatrix(a);
+      auto mb = blasMatrix(b);
+      if (!ma.ok || !mb.ok || !fits(a.width())) return false;
+      if (c.height() && c.width())
+        xgemm (ma.trans, mb.trans, c.height(), c.width(), a.width(),
+               alpha, ma.data, ma.ld, mb.data, mb.ld, beta, mc.data, mc.ld);
+      return true;
+    }
+  }
+
+  // calls with at least this much work (n, m*n or m*n*k) go to BLAS
+  inline size_t BlasThreshold() { return blas_detail::threshold; }
+  inline void SetBlasThreshold (size_t work) { blas_detail::threshold = work; }
+
+
+
+
+  namespace blas
+  {
+    enum UPLO { Lower, Upper };
+    enum DIAG { NonUnit, Unit };
+
+    template <typename T>
+    using scalar_t = blas_detail::scalar_t<T>;
+
+    // ******************** BLAS-1 ********************
+
+    // x = alpha x
+    template <typename T, typename TX>
+    void scal (scalar_t<T> alpha, VectorView<T,TX> x)
+    {
+      if constexpr (blas_detail::is_blas_type<T>)
+        if (blas_detail::useBlas(x.size()) && blas_detail::blasVector(x))
+          {
+            blas_detail::xscal (x.size(), alpha, x.data(), x.dist());
+            return;
+          }
+      for (size_t i = 0; i < x.size(); i++)
+        x(i) *= alpha;
+    }
+
+    // y += alpha x
+    template <typename T, typename TX, typename TY>
+    void axpy (scalar_t<T> alpha, VectorView<T,TX> x, VectorView<T,TY> y)
+    {
+      assert (x.size() == y.size());
+      if constexpr (blas_detail::is_blas_type<T>)
+        if (blas_detail::useBlas(x.size()) && blas_detail::blasVector(x) && blas_detail::blasVector(y))
+          {
+            blas_detail::xaxpy (x.size(), alpha, x.data(), x.dist(), y.data(), y.dist());
+            return;
+          }
+      for (size_t i = 0; i < x.size(); i++)
+        y(i) += alpha * x(i);
+    }
+
+    // sum of x(i)*y(i), not conjugated
+    template <typename T, typename TX, typename TY>
+    T dot (VectorView<T,TX> x, VectorView<T,TY> y)
+    {
+      assert (x.size() == y.size());
+      if constexpr (std::is_same_v<T,double>)
+        if (blas_detail::useBlas(x.size()) && blas_detail::blasVector(x) && blas_detail::blasVector(y))
+          {
+            integer n = x.size(), incx = x.dist(), incy = y.dist();
+            return ddot_ (&n, x.data(), &incx, y.data(), &incy);
+          }
+      return ASC_bla::dot (x, y);
+    }
+
+    // Euclidean norm
+    template <typename T, typename TX>
+    auto nrm2 (VectorView<T,TX> x)
+    {
+      if constexpr (std::is_same_v<T,double> || std::is_same_v<T,doublecomplex>)
+        if (blas_detail::useBlas(x.size()) && blas_detail::blasVector(x))
+          {
+            integer n = x.size(), incx = x.dist();
+            if constexpr (std::is_same_v<T,double>)
+              return dnrm2_ (&n, x.data(), &incx);
+            else
+              return dznrm2_ (&n, x.data(), &incx);
+          }
+      return ASC_bla::Norm (x);
+    }
+
+
+    // ******************** BLAS-2 ********************
+
+    // y = alpha A x + beta y
+    template <typename T, ORDERING ORD, typename TX, typename TY>
+    void gemv (scalar_t<T> alpha, MatrixView<T,ORD> a, VectorView<T,TX> x,
+               scalar_t<T> beta, VectorView<T,TY> y)
+    {
+      assert (a.width() == x.size() && a.height() == y.size());
+      if (a.height() == 0) return;
+      // without columns BLAS would not scale y, the loops do
+      if constexpr (blas_detail::is_blas_type<T>)
+        if (blas_detail::useBlas(a.height()*a.width()) && a.width() > 0
+            && blas_detail::blasVector(x) && blas_detail::blasVector(y))
+          {
+            auto ma = blas_detail::blasMatrix(a);
+            if (ma.ok)
+              {
+                bool n = ma.trans == 'N';
+                blas_detail::xgemv (ma.trans, n ? a.height() : a.width(), n ? a.width() : a.height(),
+                                    alpha, ma.data, ma.ld, x.data(), x.dist(), beta, y.data(), y.dist());
+                return;
+              }
+          }
+      blas_detail::gemvLib<T> (alpha, a, x, beta, y);
+    }
+
+    // A += alpha x y^T
+    template <typename T, ORDERING ORD, typename TX, typename TY>
+    void ger (scalar_t<T> alpha, VectorView<T,TX> x, VectorView<T,TY> y, MatrixView<T,ORD> a)
+    {
+      assert (a.height() == x.size() && a.width() == y.size());
+      if constexpr (blas_detail::is_blas_type<T>)
+        if (blas_detail::useBlas(a.height()*a.width())
+            && blas_detail::blasVector(x) && blas_detail::blasVector(y))
+          {
+            auto ma = blas_detail::blasMatrix(a);
+            if (ma.ok)
+              {
+                // A stored transposed: A^T += alpha y x^T
+                if (ma.trans == 'N')
+                  blas_detail::xger (a.height(), a.width(), alpha, x.data(), x.dist(),
+                                     y.data(), y.dist(), ma.data, ma.ld);
+                else
+                  blas_detail::xger (a.width(), a.height(), alpha, y.data(), y.dist(),
+                                     x.data(), x.dist(), ma.data, ma.ld);
+                return;
+              }
+          }
+      blas_detail::gerLib<T> (alpha, x, y, a);
+    }
+
+    // x = A^{-1} x, A lower or upper triangular
+    template <typename T, ORDERING ORD, typename TX>
+    void trsv (UPLO uplo, MatrixView<T,ORD> a, VectorView<T,TX> x, DIAG diag = NonUnit)
+    {
+      assert (a.height() == a.width() && a.height() == x.size());
+      if constexpr (blas_detail::is_blas_type<T>)
+        if (blas_detail::useBlas(a.height()*a.height()) && blas_detail::blasVector(x))
+          {
+            auto ma = blas_detail::blasMatrix(a);
+            if (ma.ok)
+              {
+                // the transpose of a lower triangular matrix is upper triangular
+                char ul = uplo == Lower ? 'L' : 'U';
+                if (ma.trans == 'T') ul = blas_detail::flip(ul);
+                blas_detail::xtrsv (ul, ma.trans, diag == Unit ? 'U' : 'N', a.height(),
+                                    ma.data, ma.ld, x.data(), x.dist());
+                return;
+              }
+          }
+      blas_detail::trsvLib (uplo == Lower, diag == Unit, a, x.data(), size_t(x.dist()));
+    }
+
+
+    // ******************** BLAS-3 ********************
+
+    // C = alpha A B + beta C
+    template <typename T, ORDERING ORDA, ORDERING ORDB, ORDERING ORDC>
+    void gemm (scalar_t<T> alpha, MatrixView<T,ORDA> a, MatrixView<T,ORDB> b,
+               scalar_t<T> beta, MatrixView<T,ORDC> c)
+    {
+      assert (a.width() == b.height() && a.height() == c.height() && b.width() == c.width());
+      if constexpr (blas_detail::is_blas_type<T>)
+        if (blas_detail::useBlas(c.height()*c.width()*a.width())
+            && blas_detail::gemmBlas<T> (alpha, a, b, beta, c))
+          return;
+      blas_detail::gemmLib<T> (alpha, a, b, beta, c);
+    }
+
+    // C = alpha A A^T + beta C, only the uplo triangle of C is computed
+    template <typename T, ORDERING ORDA, ORDERING ORDC>
+    void syrk (UPLO uplo, scalar_t<T> alpha, MatrixView<T,ORDA> a,
+               scalar_t<T> beta, MatrixView<T,ORDC> c)
+    {
+      assert (c.height() == c.width() && a.height() == c.height());
+      if constexpr (blas_detail::is_blas_type<T>)
+        if (blas_detail::useBlas(c.height()*c.height()*a.width()) && c.height() > 0)
+          {
+            auto ma = blas_detail::blasMatrix(a);
+            auto mc = blas_detail::blasMatrix(c);
+            if (ma.ok && mc.ok && blas_detail::fits(a.width()))
+              {
+                // C stored transposed: its lower triangle is the upper one of C^T
+                char ul = uplo == Lower ? 'L' : 'U';
+                if (mc.trans == 'T') ul = blas_detail::flip(ul);
+                blas_detail::xsyrk (ul, ma.trans, c.height(), a.width(), alpha,
+                                    ma.data, ma.ld, beta, mc.data, mc.ld);
+                return;
+              }
+          }
+      blas_detail::syrkLib<T> (uplo == Lower, alpha, a, beta, c);
+    }
+
+    /*
+      B = alpha A^{-1} B, A lower or upper triangular.
+      B A^{-1} is trsm(uplo of A^T, Trans(A), Trans(B)).
+    */
+    template <typename T, ORDERING ORDA, ORDERING ORDB>
+    void trsm (UPLO uplo, MatrixView<T,ORDA> a, MatrixView<T,ORDB> b,
+               scalar_t<T> alpha = 1, DIAG diag = NonUnit)
+    {
+      assert (a.height() == a.width() && a.height() == b.height());
+      if (b.height() == 0 || b.width() == 0) return;
+      if constexpr (blas_detail::is_blas_type<T>)
+        if (blas_detail::useBlas(a.height()*a.height()*b.width()))
+          {
+            auto ma = blas_detail::blasMatrix(a);
+            auto mb = blas_detail::blasMatrix(b);
+            if (ma.ok && mb.ok)
+              {
+                char ul = uplo == Lower ? 'L' : 'U';
+                if (ma.trans == 'T') ul = blas_detail::flip(ul);
+                char dg = diag == Unit ? 'U' : 'N';
+                if (mb.trans == 'N')
+                  blas_detail::xtrsm ('L', ul, ma.trans, dg, b.height(), b.width(),
+                                      alpha, ma.data, ma.ld, mb.data, mb.ld);
+                else
+                  // B stored transposed: B^T = alpha B^T (A^T)^{-1}
+                  blas_detail::xtrsm ('R', ul, blas_detail::flip(ma.trans), dg, b.width(), b.height(),
+                                      alpha, ma.data, ma.ld, mb.data, mb.ld);
+                return;
+              }
+          }
+      for (size_t j = 0; j < b.width(); j++)
+        {
+          T * col = &b(j,0);
+          size_t inc = b.row_dist();
+          if (alpha != T(1))
+            for (size_t i = 0; i < b.height(); i++)
+              col[i*inc] *= alpha;
+          blas_detail::trsvLib (uplo == Lower, diag == Unit, a, col, inc);
+        }
+    }
+  }
+
+
+  // BLAS-1 functions:
+
+  // y += alpha x, always with daxpy
   template <typename SX, typename SY>
   void addVectorLapack (double alpha, VectorView<double,SX> x, VectorView<double,SY> y)
   {
     integer n = x.size();
     integer incx = x.dist();
     integer incy = y.dist();
-    daxpy_ (&n, &alpha, &x(0),  &incx, &y(0), &incy);
+    daxpy_ (&n, &alpha, x.data(), &incx, y.data(), &incy);
   }
-  
-  
-  // BLAS-2 functions:
+
 
   // BLAS-3 functions:
-  
-  // int dgemm_ (char *transa, char *transb, integer *m, integer * n,
-  // integer *k, doublereal *alpha, doublereal *a, integer *lda, 
-  // doublereal *b, integer *ldb, doublereal *beta, doublereal *c__, 
-  // integer *ldc);
-
- 
-  // c = a*b
-  void multMatMatLapack (MatrixView<double> a,
-                         MatrixView<double> b,
-                         MatrixView<double> c)
+
+  /*
+    c = a*b, always with dgemm. A row major matrix is a column major
+    matrix of its transpose for BLAS, so it is passed with the 'T' flag
+    instead of being copied; a row major c is computed as c^T = b^T a^T.
+    Rows or columns of the views must be contiguous.
+  */
+  template <ORDERING ORDA, ORDERING ORDB, ORDERING ORDC>
+  void multMatMatLapack (MatrixView<double,ORDA> a,
+                         MatrixView<double,ORDB> b,
+                         MatrixView<double,ORDC> c)
   {
-    integer n = c.width();
-    integer m = c.height();
-    integer k = a.width();
-  
-    double alpha = 1.0;
-    double beta = 0;
-    integer lda = std::max((unsigned long)m, 1ul);
-    integer ldb = std::max((unsigned long)k, 1ul);
-    integer ldc = std::max((unsigned long)m, 1ul);
-
-    char transa_ ='N';
-    char transb_ ='N';
-    std::cout << "help" << ldb;
-    int err =
-      dgemm_ (&transa_, &transb_, &m, &n, &k, &alpha, 
-              a.data(), &lda, b.data(), &ldb, &beta, c.data(), &ldc);
-    std::cout << "help2: " << err;
-    if (err != 0)
-      throw std::runtime_error(std::string("MultMatMat got error "+std::to_string(err)));
-    std::cout << "help3?";
+    assert (a.height() == c.height() && b.width() == c.width() && b.height() == a.width());
+    if (!blas_detail::gemmBlas (1.0, a, b, 0.0, c))
+      throw std::runtime_error("multMatMatLapack: neither rows nor columns are contiguous");
   }
 
-  
 
-  /*
+
+  // LU factorization with dgetrf, a row major matrix is factorized as its transpose
   template <ORDERING ORD>
   class LapackLU {
     Matrix <double, ORD> a;
@@ -99,10 +637,10 @@ namespace ASC_bla
     
   public:
     LapackLU (Matrix<double,ORD> _a)
-      : a(std::move(_a)), ipiv(a.rows()) {
-      integer m = a.rows();
+      : a(std::move(_a)), ipiv(a.height()) {
+      integer m = a.height();
       if (m == 0) return;
-      integer n = a.cols();
+      integer n = a.width();
       integer lda = a.dist();
       integer info;
     
@@ -110,12 +648,14 @@ namespace ASC_bla
       //             integer * lda, integer *ipiv, integer *info);
 
       dgetrf_(&n, &m, &a(0,0), &lda, &ipiv[0], &info);
+      if (info > 0)
+        throw std::runtime_error("Matrix ist singulär und kann nicht invertiert werden.");
     }
     
     // b overwritten with A^{-1} b
     void solve (VectorView<double> b) const {
       char transa =  (ORD == ColMajor) ? 'N' : 'T';
-      integer n = a.rows();
+      integer n = a.height();
       integer nrhs = 1;
       integer lda = a.dist();
       integer ldb = b.size();
@@ -131,8 +671,8 @@ namespace ASC_bla
     Matrix<double,ORD> inverse() && {
       double hwork;
       integer lwork = -1;
-      integer n = a.Height();      
-      integer lda = a.Dist();
+      integer n = a.height();      
+      integer lda = a.dist();
       integer info;
 
       // int dgetri_(integer *n, doublereal *a, integer *lda, 
@@ -146,12 +686,7 @@ namespace ASC_bla
       dgetri_(&n, &a(0,0), &lda, ipiv.data(), &work[0], &lwork, &info);
       return std::move(a);      
     }
-
-    // Matrix<double,ORD> LFactor() const { ... }
-    // Matrix<double,ORD> UFactor() const { ... }
-    // Matrix<double,ORD> PFactor() const { ... }
   };
-  */ 
 
   
 }
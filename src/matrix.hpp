@@ -3,16 +3,39 @@
 
 #include <iostream>
 #include <algorithm>
+#include <cmath>
+#include <type_traits>
+#include <memory>
+#include <string>
 
 #include "matrixexpr.hpp"
-#include "taskmanager.hpp"
+#include "allocator.hpp"
+#include "gemm.hpp"
 
 namespace ASC_bla
 {
 
-  template <typename T>
-  class MatrixView : public MatrixExpr<MatrixView<T>>
+  /*
+    Entry (x,y) is column x, row y. ColMajor stores the columns one
+    after the other, RowMajor the rows. The ordering is a template
+    parameter, so the index formula is fixed at compile time, and the
+    transpose of a view is a view of the same memory with the other
+    ordering.
+  */
+  enum ORDERING { ColMajor, RowMajor };
+
+  constexpr ORDERING Transposed (ORDERING ord) { return ord == ColMajor ? RowMajor : ColMajor; }
+
+  template <typename T, ORDERING ORD = ColMajor, typename ALLOC = PoolAllocator<T>>
+  class Matrix;
+
+  template <typename T, ORDERING ORD = ColMajor>
+  class MappedMatrix;
+
+  template <typename T, ORDERING ORD = ColMajor>
+  class MatrixView : public MatrixExpr<MatrixView<T,ORD>>
   {
+    template <typename, ORDERING> friend class MatrixView;
   protected:
     T * m_data;
     size_t m_width;
@@ -38,18 +61,38 @@ namespace ASC_bla
       : m_data(data), m_width(width), m_height(height), m_dist_x(dist_x), m_dist_y(dist_y) { }
     
     MatrixView (size_t width, size_t height, size_t window_width, size_t window_height, size_t offset_x, size_t offset_y, T * data)
-      : m_data(data), m_width(width), m_height(height), m_window_width(width), m_window_height(height), m_offset_x(offset_x), m_offset_y(offset_y) { }
+      : m_data(data), m_width(width), m_height(height), m_window_width(window_width), m_window_height(window_height), m_offset_x(offset_x), m_offset_y(offset_y) { }
+
+    // the transposed matrix in the same memory
+    MatrixView<T,Transposed(ORD)> transpose() const
+    {
+      MatrixView<T,Transposed(ORD)> trans;
+      trans.m_data = m_data;
+      trans.m_width = m_height;
+      trans.m_height = m_width;
+      trans.m_window_width = m_window_height;
+      trans.m_window_height = m_window_width;
+      trans.m_dist_x = m_dist_y;
+      trans.m_dist_y = m_dist_x;
+      trans.m_offset_x = m_offset_y;
+      trans.m_offset_y = m_offset_x;
+      return trans;
+    }
     
     template <typename TB>
     MatrixView & operator= (const MatrixExpr<TB> & m2)
     {
       assert (this->width() == m2.width());
       assert (this->height() == m2.height());
-      for (size_t x = 0; x < this->width(); x++) {
-        for (size_t y = 0; y < this->height(); y++) {
-          (*this)(x, y) = m2(x, y);
+      const TB & expr = static_cast<const TB&>(m2);
+      if constexpr (has_product<TB>)
+        assignProductExpr (*this, expr);
+      else
+        for (size_t x = 0; x < this->width(); x++) {
+          for (size_t y = 0; y < this->height(); y++) {
+            (*this)(x, y) = expr(x, y);
+          }
         }
-      }
       return *this;
     }
 
@@ -58,7 +101,7 @@ namespace ASC_bla
 
       for (size_t x = 0; x < this->width(); x++) {
         for (size_t y = 0; y < this->height(); y++) {
-          this(x, y) = scal;
+          (*this)(x, y) = scal;
         }
       }
       return *this;
@@ -75,23 +118,49 @@ namespace ASC_bla
     size_t offset_y() const { return m_offset_y; }
     size_t window_width() const { return m_window_width; }
     size_t window_height() const { return m_window_height; }
-    
-    T & operator()(size_t x, size_t y) { return m_data[m_dist_x * (x + m_offset_x) * m_height + m_dist_y * (y + m_offset_y)]; }
-    const T & operator()(size_t x, size_t y) const { return m_data[m_dist_x * (x + m_offset_x) * m_height + m_dist_y * (y + m_offset_y)]; }
+    // distances between consecutive rows and consecutive columns
+    size_t row_dist() const { return ORD == ColMajor ? m_dist_y : m_dist_y * m_width; }
+    size_t col_dist() const { return ORD == ColMajor ? m_dist_x * m_height : m_dist_x; }
+    // leading dimension: distance between columns (ColMajor) or rows (RowMajor)
+    size_t dist() const { return ORD == ColMajor ? col_dist() : row_dist(); }
+
+    T & operator()(size_t x, size_t y) { return m_data[index(x,y)]; }
+    const T & operator()(size_t x, size_t y) const { return m_data[index(x,y)]; }
+
+  private:
+    size_t index (size_t x, size_t y) const
+    {
+      if constexpr (ORD == ColMajor)
+        return m_dist_x * (x + m_offset_x) * m_height + m_dist_y * (y + m_offset_y);
+      else
+        return m_dist_y * (y + m_offset_y) * m_width + m_dist_x * (x + m_offset_x);
+    }
       
   };
   
-  template <typename T>
-  class Matrix : public MatrixView<T>
+  // ALLOC is a stateless allocator, by default aligned memory from the pool
+  template <typename T, ORDERING ORD, typename ALLOC>
+  class Matrix : public MatrixView<T,ORD>
   {
-    typedef MatrixView<T> BASE;
+    typedef MatrixView<T,ORD> BASE;
     using BASE::m_width;
     using BASE::m_height;
     using BASE::m_data;
+
+    // the expression constructors write all entries right away
+    struct NoFirstTouch { };
+    Matrix (size_t width, size_t height, NoFirstTouch)
+      : BASE (width, height, ALLOC().allocate(width * height))
+    {
+      std::uninitialized_default_construct_n (m_data, width*height);
+    }
     
   public:
     Matrix (size_t width, size_t height) 
-      : MatrixView<T> (width, height, new T[width * height]) { ; }
+      : Matrix (width, height, NoFirstTouch())
+    {
+      ASC_HPC::ParallelFirstTouch (m_data, width*height);
+    }
     
     Matrix (const Matrix & m)
       : Matrix(m.width(), m.height())
@@ -100,21 +169,24 @@ namespace ASC_bla
     }
 
     Matrix (Matrix && m)
-      : MatrixView<T> (0, 0, nullptr)
+      : BASE (0, 0, nullptr)
     {
-      std::swap(m_width, m.m_width);
-      std::swap(m_height, m.m_height);
-      std::swap(m_data, m.m_data);
+      *this = std::move(m);
     }
 
     template <typename TB>
     Matrix (const MatrixExpr<TB> & m)
-      : Matrix(m.width(), m.height())
+      : Matrix(m.width(), m.height(), NoFirstTouch())
     {
       *this = m;
     }
 
-    ~Matrix () { delete [] m_data; }
+    ~Matrix ()
+    {
+      if (!m_data) return;
+      std::destroy_n (m_data, m_width*m_height);
+      ALLOC().deallocate (m_data, m_width*m_height);
+    }
     
     using BASE::operator=;
     Matrix & operator=(const Matrix & m2)
@@ -131,24 +203,25 @@ namespace ASC_bla
 
     Matrix & operator= (Matrix && m2)
     {
-      assert (this->width() == m2.width());
-      assert (this->height() == m2.height());
-      for (size_t x = 0; x < this->width(); x++) {
-        for (size_t y = 0; y < this->height(); y++) {
-            this(x,y) = m2(x,y);   
-        }
-      }
+      std::swap(m_width, m2.m_width);
+      std::swap(m_height, m2.m_height);
+      std::swap(this->m_window_width, m2.m_window_width);
+      std::swap(this->m_window_height, m2.m_window_height);
+      std::swap(m_data, m2.m_data);
       return *this;
     }
     
-    Matrix<T> Inverse() const
+    // view of a matrix file mapped into memory (see matrixfile.hpp)
+    static MappedMatrix<T,ORD> mmap (const std::string & path, bool writable = false);
+
+    Matrix<T,ORD> Inverse() const
       {
         if (m_width != m_height)
           throw std::runtime_error("Matrix muss quadratisch sein, um invertiert zu werden.");
 
         size_t n = m_width;
-        Matrix<T> A(*this);
-        Matrix<T> I(n, n);
+        Matrix<T,ORD> A(*this);
+        Matrix<T,ORD> I(n, n);
 
         for (size_t i = 0; i < n; ++i) {
           for (size_t j = 0; j < n; ++j) {
@@ -200,57 +273,242 @@ namespace ASC_bla
       }
   };
 
-  template<typename T>
-  void addMatMat (MatrixView<T> A, MatrixView<T> B, MatrixView<T> C) {
-    constexpr size_t BH=96;
-    constexpr size_t BW=96;
-    size_t x_count = (A.width() + BW - 1) / BW;
-    size_t y_count = (A.height() + BH - 1) / BH;
 
-    ASC_HPC::StartWorkers(2);
-    
-    ASC_HPC::RunParallel(x_count * y_count, [y_count, A, B, C] (int index, int nr) {
-      constexpr size_t BH=96;
-      constexpr size_t BW=96;
-      alignas (64) double memBA[BH*BW];
-      
-      size_t x = (size_t) index % y_count;
-      size_t y = (size_t) index / y_count;
+  // ***************** assignment of expressions with products *****************
 
-      size_t i1 = y * BH;
-      size_t j1 = x * BW;
+  /*
+    C = expr, where expr contains matrix-matrix products.
+    The expression is split into its products, which are computed by gemm,
+    and the remaining "plain" part, which is evaluated entry by entry.
+    If the plain part is a single (scaled) matrix D, it goes into the
+    epilogue of the first gemm, i.e. C = A*B + 2*D is one pass over C.
+    Views of either ordering go to gemm with their row and column
+    distances, so a transposed operand is never copied.
+  */
 
-      size_t i2 = std::min(A.height(), i1+BH);
-      size_t j2 = std::min(A.width(), j1+BW);
+  template <typename T>
+  constexpr bool is_matrix_view = false;
+  template <typename T, ORDERING ORD>
+  constexpr bool is_matrix_view<MatrixView<T,ORD>> = true;
+  template <typename T, ORDERING ORD, typename ALLOC>
+  constexpr bool is_matrix_view<Matrix<T,ORD,ALLOC>> = true;
+
+  // 0 .. no plain part, 1 .. one (scaled) matrix, 2 .. general
+  template <typename TE>
+  constexpr int plain_kind = is_matrix_view<TE> ? 1 : 2;
+  template <typename TA, typename TB>
+  constexpr int plain_kind<MultiplyMatrixExpr<TA,TB>> = 0;
+  template <typename TA, typename TB>
+  constexpr int plain_kind<SumMatrixExpr<TA,TB>> =
+    (plain_kind<TA> == 0) ? plain_kind<TB> : ((plain_kind<TB> == 0) ? plain_kind<TA> : 2);
+  template <typename TSCAL, typename TV>
+  constexpr int plain_kind<ScaleMatrixExpr<TSCAL,TV>> = plain_kind<TV>;
+
+  // entry (x,y) of the plain part
+  template <typename TE>
+  auto plainEntry (const TE & e, size_t x, size_t y) { return e(x,y); }
+  template <typename TA, typename TB>
+  auto plainEntry (const MultiplyMatrixExpr<TA,TB> & e, size_t x, size_t y) { return decltype(e(x,y))(0); }
+  template <typename TA, typename TB>
+  auto plainEntry (const SumMatrixExpr<TA,TB> & e, size_t x, size_t y)
+  { return plainEntry(e.left(), x, y) + plainEntry(e.right(), x, y); }
+  template <typename TSCAL, typename TV>
+  auto plainEntry (const ScaleMatrixExpr<TSCAL,TV> & e, size_t x, size_t y)
+  { return e.scalar() * plainEntry(e.matrix(), x, y); }
+
+  // calls f(scale, D) for a plain part of kind 1
+  template <typename T, typename TE, typename F>
+  void plainMatrix (const TE & e, T scale, F f)
+  {
+    if constexpr (is_matrix_view<TE>)
+      f(scale, e);
+    else if constexpr (has_product<TE>)
+      {
+        if constexpr (plain_kind<std::decay_t<decltype(e.left())>> == 1)
+          plainMatrix (e.left(), scale, f);
+        else
+          plainMatrix (e.right(), scale, f);
+      }
+  }
+  template <typename T, typename TSCAL, typename TV, typename F>
+  void plainMatrix (const ScaleMatrixExpr<TSCAL,TV> & e, T scale, F f)
+  {
+    plainMatrix (e.matrix(), T(scale*e.scalar()), f);
+  }
 
-      size_t w = j2-j1;
-      size_t h = i2-i1;
+  // calls f with a MatrixView of e in its own ordering, expressions are evaluated into a temporary
+  template <typename T, typename TE, typename F>
+  void withMatrixView (const TE & e, F f)
+  {
+    if constexpr (std::is_convertible_v<const TE*, const MatrixView<T,ColMajor>*>)
+      f(MatrixView<T,ColMajor>(e));
+    else if constexpr (std::is_convertible_v<const TE*, const MatrixView<T,RowMajor>*>)
+      f(MatrixView<T,RowMajor>(e));
+    else
+      {
+        Matrix<T> tmp(e);
+        f(MatrixView<T>(tmp));
+      }
+  }
 
-      MatrixView<T> Ablock(w, h, memBA);
-      MatrixView<T> ASub(A.full_width(), A.full_height(), w, h, j1, i1, A.data());
-      MatrixView<T> BSub(B.full_width(), B.full_height(), B.window_width(), w, B.offset_x(), j1, B.data());
-      MatrixView<T> CSub(C.full_width(), C.full_height(), C.window_width(), w, C.offset_x(), j1, C.data());
-      Ablock = ASub;
+  template <typename T, ORDERING ORDA, ORDERING ORDB>
+  bool overlaps (const MatrixView<T,ORDA> & a, const MatrixView<T,ORDB> & b)
+  {
+    const T * a0 = a.data(), * a1 = a0 + a.full_width()*a.full_height();
+    const T * b0 = b.data(), * b1 = b0 + b.full_width()*b.full_height();
+    return a0 < b1 && b0 < a1;
+  }
+
+  // is any matrix below a product stored in the memory of C ?
+  template <typename T, ORDERING ORD, typename TE>
+  bool productOverlaps (const MatrixView<T,ORD> & C, const TE & e, bool inproduct)
+  {
+    bool result = false;
+    if constexpr (std::is_convertible_v<const TE*, const MatrixView<T,ColMajor>*>
+                  || std::is_convertible_v<const TE*, const MatrixView<T,RowMajor>*>)
+      if (inproduct)
+        withMatrixView<T> (e, [&] (auto M) { result = overlaps(C, M); });
+    return result;
+  }
+  template <typename T, ORDERING ORD, typename TA, typename TB>
+  bool productOverlaps (const MatrixView<T,ORD> & C, const MultiplyMatrixExpr<TA,TB> & e, bool inproduct)
+  {
+    return productOverlaps(C, e.left(), true) || productOverlaps(C, e.right(), true);
+  }
+  template <typename T, ORDERING ORD, typename TA, typename TB>
+  bool productOverlaps (const MatrixView<T,ORD> & C, const SumMatrixExpr<TA,TB> & e, bool inproduct)
+  {
+    return productOverlaps(C, e.left(), inproduct) || productOverlaps(C, e.right(), inproduct);
+  }
+  template <typename T, ORDERING ORD, typename TSCAL, typename TV>
+  bool productOverlaps (const MatrixView<T,ORD> & C, const ScaleMatrixExpr<TSCAL,TV> & e, bool inproduct)
+  {
+    return productOverlaps(C, e.matrix(), inproduct);
+  }
 
+  // C = beta*D + s*(products in e), beta and D switch to 1 and C after the first product
+  template <typename T, ORDERING ORD, typename TE>
+  void addProducts (MatrixView<T,ORD> C, T s, const TE & e, T & beta, MatrixView<T,ORD> & D) { }
 
-      addMatMat2(Ablock, BSub, CSub);
+  template <typename T, ORDERING ORD, typename TA, typename TB>
+  void addProducts (MatrixView<T,ORD> C, T s, const MultiplyMatrixExpr<TA,TB> & e, T & beta, MatrixView<T,ORD> & D)
+  {
+    withMatrixView<T> (e.left(), [&] (auto A)
+    {
+      withMatrixView<T> (e.right(), [&] (auto B)
+      {
+        gemm (C.height(), C.width(), A.width(), s,
+              A.data() ? &A(0,0) : nullptr, A.row_dist(), A.col_dist(),
+              B.data() ? &B(0,0) : nullptr, B.row_dist(), B.col_dist(),
+              beta, &D(0,0), D.row_dist(), D.col_dist(),
+              &C(0,0), C.row_dist(), C.col_dist());
+      });
     });
+    beta = T(1);
+    D = C;
+  }
 
-    ASC_HPC::StopWorkers();
+  template <typename T, ORDERING ORD, typename TA, typename TB>
+  void addProducts (MatrixView<T,ORD> C, T s, const SumMatrixExpr<TA,TB> & e, T & beta, MatrixView<T,ORD> & D)
+  {
+    addProducts (C, s, e.left(), beta, D);
+    addProducts (C, s, e.right(), beta, D);
   }
 
-  template<typename T>
-  void addMatMat2 (MatrixView<T> A, MatrixView<T> B, MatrixView<T> C) {
-    constexpr size_t H=4;
-    constexpr size_t W=12;
+  template <typename T, ORDERING ORD, typename TSCAL, typename TV>
+  void addProducts (MatrixView<T,ORD> C, T s, const ScaleMatrixExpr<TSCAL,TV> & e, T & beta, MatrixView<T,ORD> & D)
+  {
+    addProducts (C, T(s*e.scalar()), e.matrix(), beta, D);
+  }
 
-    /*for (size_t j = 0; j+W <= C.width(); j += W) 
-      for (size_t i = 0; i+H <= C.height(); i += H)
-        AddMatMatKernel<H,W> (A.width(), &A(i,0), A.dist(),
-                            &B(0,j), B.dist(), &C(i,j), C.dist());*/
-    // leftover rows and cols
+  template <typename T, ORDERING ORD, typename TE>
+  void assignProductExpr (MatrixView<T,ORD> C, const TE & e)
+  {
+    if (C.width() == 0 || C.height() == 0) return;
 
-    std::cout << "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaargh";
+    if (productOverlaps(C, e, false))
+      {
+        // C = C*A and the like
+        Matrix<T,ORD> tmp(C.width(), C.height());
+        assignProductExpr (MatrixView<T,ORD>(tmp), e);
+        for (size_t x = 0; x < C.width(); x++)
+          for (size_t y = 0; y < C.height(); y++)
+            C(x,y) = tmp(x,y);
+        return;
+      }
+
+    T beta = T(0);
+    MatrixView<T,ORD> D = C;
+    bool plain_done = false;
+    if constexpr (plain_kind<TE> == 1)
+      plainMatrix (e, T(1), [&] (T scale, const auto & m)
+      {
+        // a D of the other ordering is added entry by entry
+        if constexpr (std::is_convertible_v<decltype(&m), const MatrixView<T,ORD>*>)
+          {
+            // D may be C itself, but not a shifted window of it
+            MatrixView<T,ORD> M(m);
+            if (overlaps(C, M) && (&M(0,0) != &C(0,0) || M.dist() != C.dist() || M.dist_y() != C.dist_y()))
+              return;
+            beta = scale;
+            D = M;
+            plain_done = true;
+          }
+      });
+    if constexpr (plain_kind<TE> != 0)
+      if (!plain_done)
+        {
+          for (size_t x = 0; x < C.width(); x++)
+            for (size_t y = 0; y < C.height(); y++)
+              C(x,y) = plainEntry(e, x, y);
+          beta = T(1);
+        }
+
+    addProducts (C, T(1), e, beta, D);
+  }
+
+
+  // C += A*B on one core, without packing
+  template<typename T, ORDERING ORDA, ORDERING ORDB, ORDERING ORDC>
+  void addMatMat2 (MatrixView<T,ORDA> A, MatrixView<T,ORDB> B, MatrixView<T,ORDC> C) {
+    assert (A.width() == B.height());
+    assert (A.height() == C.height());
+    assert (B.width() == C.width());
+
+    size_t h = C.height();
+    size_t w = C.width();
+    size_t k = A.width();
+    if (h == 0 || w == 0 || k == 0) return;
+
+    if (A.row_dist() != 1 || C.row_dist() != 1)
+      {
+        // rows are not contiguous, no vector loads
+        for (size_t j = 0; j < w; j++)
+          for (size_t l = 0; l < k; l++)
+            for (size_t i = 0; i < h; i++)
+              C(j,i) += A(l,i) * B(j,l);
+        return;
+      }
+
+    gemmUnpacked (h, w, k, T(1), &A(0,0), A.col_dist(), &B(0,0), B.row_dist(), B.col_dist(),
+                  T(1), &C(0,0), C.col_dist(), &C(0,0), C.col_dist());
+  }
+
+
+  // C += A*B, packed and cache-blocked, in parallel on the ASC_HPC workers
+  template<typename T, ORDERING ORDA, ORDERING ORDB, ORDERING ORDC>
+  void addMatMat (MatrixView<T,ORDA> A, MatrixView<T,ORDB> B, MatrixView<T,ORDC> C) {
+    assert (A.width() == B.height());
+    assert (A.height() == C.height());
+    assert (B.width() == C.width());
+
+    if (C.height() == 0 || C.width() == 0) return;
+    if (A.width() == 0) return;
+
+    gemm (C.height(), C.width(), A.width(), T(1),
+          &A(0,0), A.row_dist(), A.col_dist(),
+          &B(0,0), B.row_dist(), B.col_dist(),
+          T(1), &C(0,0), C.row_dist(), C.col_dist());
   }
 
 
@@ -266,6 +524,13 @@ namespace ASC_bla
     return sum;
   }*/
 
+  // transposed view, no copy
+  template <typename T, ORDERING ORD>
+  MatrixView<T,Transposed(ORD)> Trans (const MatrixView<T,ORD> & m)
+  {
+    return m.transpose();
+  }
+
   template <typename T>
   Matrix<T> operator- (const Matrix<T> & a, const Matrix<T> & b)
   {
@@ -284,7 +549,7 @@ namespace ASC_bla
     for (size_t y = 0; y < m.height(); y++) {
         for (size_t x = 0; x < m.width(); x++) {
             ost << m(x,y);
-            if (x < m.height() - 1) {
+            if (x+1 < m.width()) {
                 ost << ", ";
             } else {
                 ost << "\n";
@@ -296,3 +561,5 @@ namespace ASC_bla
   
 }
 #endif
+
+#include "matrixfile.hpp"
@@ -3,6 +3,8 @@
 
 #include <cassert>
 
+#include "vecexpr.hpp"
+
 namespace ASC_bla
 {
 
@@ -10,7 +12,7 @@ namespace ASC_bla
   class MatrixExpr
   {
   public:
-    auto derived() const { return static_cast<const T&> (*this); }
+    const T & derived() const { return static_cast<const T&> (*this); }
     size_t width() const { return derived().width(); }
     size_t height() const { return derived().height(); }
     auto operator() (size_t x, size_t y) const { return derived()(x,y); }
@@ -25,6 +27,8 @@ namespace ASC_bla
     TB b;
   public:
     SumMatrixExpr (TA _a, TB _b) : a(_a), b(_b) { }
+    const TA & left() const { return a; }
+    const TB & right() const { return b; }
     auto operator() (size_t x, size_t y) const { return a(x,y)+b(x,y); }
     size_t width() const { return a.width(); }      
     size_t height() const { return a.height(); }      
@@ -35,7 +39,7 @@ namespace ASC_bla
   {
     assert (a.width() == b.width());
     assert (a.height() == b.height());
-    return SumMatrixExpr(a.derived(), b.derived());
+    return SumMatrixExpr<expr_operand_t<TA>, expr_operand_t<TB>> (a.derived(), b.derived());
   }
 
 
@@ -48,6 +52,8 @@ namespace ASC_bla
     TV vec;
   public:
     ScaleMatrixExpr (TSCAL _scal, TV _vec) : scal(_scal), vec(_vec) { }
+    TSCAL scalar() const { return scal; }
+    const TV & matrix() const { return vec; }
     auto operator() (size_t x, size_t y) const { return scal*vec(x,y); }
     size_t width() const { return vec.width(); }      
     size_t height() const { return vec.height(); }      
@@ -56,7 +62,7 @@ namespace ASC_bla
   template <typename T>
   auto operator* (double scal, const MatrixExpr<T> & v)
   {
-    return ScaleMatrixExpr(scal, v.derived());
+    return ScaleMatrixExpr<double, expr_operand_t<T>> (scal, v.derived());
   }
 
 
@@ -69,25 +75,39 @@ namespace ASC_bla
     TB b;
   public:
     MultiplyMatrixExpr (TA _a, TB _b) : a(_a), b(_b) { }
+    const TA & left() const { return a; }
+    const TB & right() const { return b; }
+    // entry in column x, row y. Assigning the product to a matrix
+    // does not come here but goes to gemm (see matrix.hpp)
     auto operator() (size_t x, size_t y) const { 
-      auto s = 0;
+      decltype(a(0,0)*b(0,0)) s = 0;
       for (size_t i = 0; i < a.width(); i++) {
-        s += a(x, i) * b(i, y);
+        s += a(i, y) * b(x, i);
       }
       return s;
      }
-    size_t width() const { return a.width(); }      
+    size_t width() const { return b.width(); }      
     size_t height() const { return a.height(); }      
   };
   
   template <typename TA, typename TB>
   auto operator* (const MatrixExpr<TA> & a, const MatrixExpr<TB> & b)
   {
-    assert (a.width() == b.width());
-    assert (a.height() == b.height());
-    return MultiplyMatrixExpr(a.derived(), b.derived());
+    assert (a.width() == b.height());
+    return MultiplyMatrixExpr<expr_operand_t<TA>, expr_operand_t<TB>> (a.derived(), b.derived());
   }
 
+
+  // does the expression contain a matrix-matrix product ?
+  template <typename T>
+  constexpr bool has_product = false;
+  template <typename TA, typename TB>
+  constexpr bool has_product<MultiplyMatrixExpr<TA,TB>> = true;
+  template <typename TA, typename TB>
+  constexpr bool has_product<SumMatrixExpr<TA,TB>> = has_product<TA> || has_product<TB>;
+  template <typename TSCAL, typename TV>
+  constexpr bool has_product<ScaleMatrixExpr<TSCAL,TV>> = has_product<TV>;
+
   // ***************** Output operator *****************
 
   template <typename T>
@@ -96,7 +116,7 @@ namespace ASC_bla
     for (size_t y = 0; y < m.height(); y++) {
         for (size_t x = 0; x < m.width(); x++) {
             ost << m(x,y);
-            if (x < m.height() - 1) {
+            if (x+1 < m.width()) {
                 ost << ", ";
             } else {
                 ost << "\n";
@@ -0,0 +1,112 @@
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "matrixfile.hpp"
+
+
+namespace ASC_bla
+{
+
+#ifdef _WIN32
+
+  FileMapping :: FileMapping (const std::string & path, bool writable)
+    : m_writable(writable)
+  {
+    HANDLE file = CreateFileA (path.c_str(), writable ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ,
+                               FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING,
+                               FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+      throw std::runtime_error ("cannot open " + path);
+    LARGE_INTEGER size;
+    GetFileSizeEx (file, &size);
+    m_bytes = size.QuadPart;
+    if (m_bytes > 0)
+      {
+        HANDLE map = CreateFileMappingA (file, nullptr, writable ? PAGE_READWRITE : PAGE_READONLY,
+                                         0, 0, nullptr);
+        if (map)
+          {
+            m_data = static_cast<char*> (MapViewOfFile (map, writable ? FILE_MAP_WRITE : FILE_MAP_READ,
+                                                        0, 0, 0));
+            CloseHandle (map);
+          }
+        if (!m_data)
+          {
+            CloseHandle (file);
+            throw std::runtime_error ("cannot map " + path);
+          }
+      }
+    CloseHandle (file);
+  }
+
+  FileMapping :: ~FileMapping()
+  {
+    if (m_data) UnmapViewOfFile (m_data);
+  }
+
+#else
+
+  FileMapping :: FileMapping (const std::string & path, bool writable)
+    : m_writable(writable)
+  {
+    int fd = open (path.c_str(), writable ? O_RDWR : O_RDONLY);
+    if (fd < 0)
+      throw std::runtime_error ("cannot open " + path + ": " + std::strerror(errno));
+    struct stat st;
+    if (fstat (fd, &st) != 0)
+      {
+        int err = errno;
+        close (fd);
+        throw std::runtime_error ("cannot stat " + path + ": " + std::strerror(err));
+      }
+    m_bytes = st.st_size;
+    if (m_bytes > 0)
+      {
+        // shared mappings of the same file use the same pages of the page cache
+        void * p = ::mmap (nullptr, m_bytes, writable ? PROT_READ | PROT_WRITE : PROT_READ,
+                           MAP_SHARED, fd, 0);
+        if (p == MAP_FAILED)
+          {
+            int err = errno;
+            close (fd);
+            throw std::runtime_error ("cannot map " + path + ": " + std::strerror(err));
+          }
+        m_data = static_cast<char*>(p);
+      }
+    close (fd);
+  }
+
+  FileMapping :: ~FileMapping()
+  {
+    if (m_data) munmap (m_data, m_bytes);
+  }
+
+#endif
+
+  FileMapping :: FileMapping (FileMapping && other)
+    : m_data(std::exchange(other.m_data, nullptr)),
+      m_bytes(std::exchange(other.m_bytes, 0)),
+      m_writable(other.m_writable) { }
+
+  FileMapping & FileMapping :: operator= (FileMapping && other)
+  {
+    std::swap (m_data, other.m_data);
+    std::swap (m_bytes, other.m_bytes);
+    std::swap (m_writable, other.m_writable);
+    return *this;
+  }
+
+}
@@ -0,0 +1,299 @@
+#ifndef FILE_MATRIXFILE
+#define FILE_MATRIXFILE
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <complex>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "matrix.hpp"
+
+/*
+  Matrix files: a header of MATRIX_FILE_ALIGNMENT bytes, followed by
+  the entries as raw data. The header stores the format version, the
+  element type in NumPy notation ("<f8" is a little endian double),
+  the ordering ('F' column major, 'C' row major) and the shape, so
+  files can also be read from other tools.
+
+  The data starts at a page boundary, so MappedMatrix maps the file
+  and works directly on the page cache: several processes mapping the
+  same file read-only share one copy in memory.
+*/
+
+namespace ASC_bla
+{
+
+  constexpr uint32_t MATRIX_FILE_VERSION = 1;
+  constexpr size_t MATRIX_FILE_ALIGNMENT = 4096;
+
+  struct MatrixFileHeader
+  {
+    char magic[8];           // "ASC-bla", zero terminated
+    uint32_t version;
+    uint32_t header_size;    // sizeof(MatrixFileHeader) of the writer
+    char dtype[8];           // zero terminated
+    char ordering;           // 'F' or 'C'
+    char reserved[7];
+    uint64_t rows;
+    uint64_t cols;
+    uint64_t alignment;      // data_offset is a multiple of it
+    uint64_t data_offset;    // bytes from the begin of the file to the first entry
+  };
+
+  constexpr char MATRIX_FILE_MAGIC[8] = "ASC-bla";
+
+  inline char nativeEndian()
+  {
+    uint16_t one = 1;
+    return (*reinterpret_cast<const char*>(&one) == 1) ? '<' : '>';
+  }
+
+  template <typename T> const char * dtypeSize();
+  template <> inline const char * dtypeSize<float>() { return "f4"; }
+  template <> inline const char * dtypeSize<double>() { return "f8"; }
+  template <> inline const char * dtypeSize<std::complex<float>>() { return "c8"; }
+  template <> inline const char * dtypeSize<std::complex<double>>() { return "c16"; }
+
+  // NumPy type string of T in native byte order
+  template <typename T>
+  std::string dtypeName()
+  {
+    return std::string(1, nativeEndian()) + dtypeSize<T>();
+  }
+
+  template <typename T>
+  MatrixFileHeader makeMatrixFileHeader (size_t rows, size_t cols, char ordering = 'F')
+  {
+    MatrixFileHeader header;
+    std::memset (&header, 0, sizeof(header));
+    std::memcpy (header.magic, MATRIX_FILE_MAGIC, sizeof(header.magic));
+    header.version = MATRIX_FILE_VERSION;
+    header.header_size = sizeof(MatrixFileHeader);
+    std::strncpy (header.dtype, dtypeName<T>().c_str(), sizeof(header.dtype)-1);
+    header.ordering = ordering;
+    header.rows = rows;
+    header.cols = cols;
+    header.alignment = MATRIX_FILE_ALIGNMENT;
+    header.data_offset = MATRIX_FILE_ALIGNMENT;
+    return header;
+  }
+
+  // throws if the file is not a matrix file of T with file_bytes bytes
+  template <typename T>
+  void checkMatrixFileHeader (const MatrixFileHeader & header, size_t file_bytes,
+                              const std::string & path)
+  {
+    if (file_bytes < sizeof(MatrixFileHeader) ||
+        std::memcmp (header.magic, MATRIX_FILE_MAGIC, sizeof(header.magic)) != 0)
+      throw std::runtime_error (path + " is not a matrix file");
+    if (header.version != MATRIX_FILE_VERSION)
+      throw std::runtime_error (path + ": unsupported matrix file version "
+                                + std::to_string(header.version));
+    std::string dtype(header.dtype, std::find(header.dtype, header.dtype+sizeof(header.dtype), '\0'));
+    if (dtype != dtypeName<T>())
+      throw std::runtime_error (path + ": matrix of " + dtype + ", expected " + dtypeName<T>());
+    if (header.data_offset < sizeof(MatrixFileHeader) || header.data_offset % alignof(T) != 0)
+      throw std::runtime_error (path + ": bad data offset");
+    if (header.ordering != 'F' && header.ordering != 'C')
+      throw std::runtime_error (path + ": unknown ordering");
+    // rows*cols*sizeof(T) may overflow for a corrupt header, divide instead
+    if (file_bytes < header.data_offset ||
+        header.rows > (file_bytes - header.data_offset) / sizeof(T) / std::max<uint64_t>(header.cols, 1))
+      throw std::runtime_error (path + ": file is shorter than its matrix");
+  }
+
+
+  /*
+    Writes a matrix file column by column, so a matrix can be saved
+    while it is computed, without holding it in memory. The shape is
+    fixed by the constructor, append() adds the next columns. A row
+    major file (ordering 'C') is written row by row instead, and
+    append() adds the next rows.
+  */
+  template <typename T>
+  class MatrixFileWriter
+  {
+    std::ofstream out;
+    std::string path;
+    size_t rows, cols;
+    char ordering;
+    size_t length, count;    // of the columns, or the rows for 'C'
+    size_t written = 0;
+    std::vector<T> buffer;
+
+    // the columns of m are the next lines of the file
+    template <ORDERING ORD>
+    void appendLines (const MatrixView<T,ORD> & m)
+    {
+      for (size_t x = 0; x < m.width(); x++)
+        {
+          const T * line = &m(x,0);
+          if (m.row_dist() != 1)
+            {
+              buffer.resize(length);
+              for (size_t y = 0; y < length; y++)
+                buffer[y] = m(x,y);
+              line = buffer.data();
+            }
+          out.write (reinterpret_cast<const char*>(line), length*sizeof(T));
+        }
+    }
+
+    const char * lineName() const { return ordering == 'C' ? " rows" : " columns"; }
+
+  public:
+    MatrixFileWriter (const std::string & _path, size_t _rows, size_t _cols, char _ordering = 'F')
+      : out(_path, std::ios::binary | std::ios::trunc), path(_path), rows(_rows), cols(_cols),
+        ordering(_ordering), length(_ordering == 'C' ? _cols : _rows), count(_ordering == 'C' ? _rows : _cols)
+    {
+      if (ordering != 'F' && ordering != 'C')
+        throw std::runtime_error ("unknown ordering for " + path);
+      if (!out)
+        throw std::runtime_error ("cannot open " + path + " for writing");
+      MatrixFileHeader header = makeMatrixFileHeader<T> (rows, cols, ordering);
+      std::vector<char> block(header.data_offset, 0);
+      std::memcpy (block.data(), &header, sizeof(header));
+      out.write (block.data(), block.size());
+    }
+
+    MatrixFileWriter (const MatrixFileWriter &) = delete;
+    MatrixFileWriter & operator= (const MatrixFileWriter &) = delete;
+
+    // columns, or rows of a 'C' file
+    size_t columnsWritten() const { return written; }
+
+    template <ORDERING ORD>
+    void append (const MatrixView<T,ORD> & block)
+    {
+      size_t num = (ordering == 'C') ? block.height() : block.width();
+      size_t len = (ordering == 'C') ? block.width() : block.height();
+      if (len != length || written + num > count)
+        throw std::runtime_error (path + ":" + lineName() + " do not fit into the matrix");
+      if (ordering == 'C')
+        appendLines (Trans(block));
+      else
+        appendLines (block);
+      written += num;
+      if (!out)
+        throw std::runtime_error ("write error on " + path);
+    }
+
+    // throws if not all columns were appended
+    void close()
+    {
+      if (!out.is_open()) return;
+      out.close();
+      if (written != count)
+        throw std::runtime_error (path + ": " + std::to_string(written) + " of "
+                                  + std::to_string(count) + lineName() + " written");
+      if (!out)
+        throw std::runtime_error ("write error on " + path);
+    }
+  };
+
+
+  // a ColMajor matrix is saved as an 'F' file, a RowMajor matrix as a 'C' file
+  template <typename T, ORDERING ORD>
+  void SaveMatrix (const std::string & path, const MatrixView<T,ORD> & m)
+  {
+    MatrixFileWriter<T> writer(path, m.height(), m.width(), ORD == ColMajor ? 'F' : 'C');
+    if (m.width() && m.height())
+      writer.append (m);
+    writer.close();
+  }
+
+  // reads the file into a new matrix, row major files are transposed to column major
+  template <typename T>
+  Matrix<T> LoadMatrix (const std::string & path)
+  {
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    if (!in)
+      throw std::runtime_error ("cannot open " + path);
+    size_t file_bytes = in.tellg();
+    in.seekg(0);
+    MatrixFileHeader header;
+    std::memset (&header, 0, sizeof(header));
+    in.read (reinterpret_cast<char*>(&header), std::min(sizeof(header), file_bytes));
+    checkMatrixFileHeader<T> (header, file_bytes, path);
+
+    Matrix<T> m(header.cols, header.rows);
+    in.seekg (header.data_offset);
+    if (header.ordering == 'F')
+      in.read (reinterpret_cast<char*>(m.data()), header.rows*header.cols*sizeof(T));
+    else
+      {
+        std::vector<T> row(header.cols);
+        for (size_t y = 0; y < header.rows; y++)
+          {
+            in.read (reinterpret_cast<char*>(row.data()), header.cols*sizeof(T));
+            for (size_t x = 0; x < header.cols; x++)
+              m(x,y) = row[x];
+          }
+      }
+    if (!in)
+      throw std::runtime_error ("read error on " + path);
+    return m;
+  }
+
+
+  // a file mapped into memory, unmapped by the destructor
+  class FileMapping
+  {
+    char * m_data = nullptr;
+    size_t m_bytes = 0;
+    bool m_writable = false;
+  public:
+    FileMapping() = default;
+    FileMapping (const std::string & path, bool writable);
+    FileMapping (FileMapping && other);
+    FileMapping & operator= (FileMapping && other);
+    ~FileMapping();
+
+    char * data() const { return m_data; }
+    size_t bytes() const { return m_bytes; }
+    bool writable() const { return m_writable; }
+  };
+
+  /*
+    MatrixView of a matrix file, mapped into memory. The file must have
+    the ordering of the view: 'F' for ColMajor, 'C' for RowMajor.
+    Read-only by default; a writable mapping writes changes through
+    to the file.
+  */
+  template <typename T, ORDERING ORD>
+  class MappedMatrix : private FileMapping, public MatrixView<T,ORD>
+  {
+    static const MatrixFileHeader & header (const FileMapping & mapping, const std::string & path)
+    {
+      if (mapping.bytes() < sizeof(MatrixFileHeader))
+        throw std::runtime_error (path + " is not a matrix file");
+      auto & h = *reinterpret_cast<const MatrixFileHeader*>(mapping.data());
+      checkMatrixFileHeader<T> (h, mapping.bytes(), path);
+      if (h.ordering != (ORD == ColMajor ? 'F' : 'C'))
+        throw std::runtime_error (path + (ORD == ColMajor ? ": not a column major file"
+                                          : ": not a row major file"));
+      return h;
+    }
+  public:
+    MappedMatrix (const std::string & path, bool writable = false)
+      : FileMapping(path, writable),
+        MatrixView<T,ORD> (header(*this, path).cols, header(*this, path).rows,
+                           reinterpret_cast<T*>(FileMapping::data() + header(*this, path).data_offset)) { }
+
+    using MatrixView<T,ORD>::data;
+    using FileMapping::writable;
+  };
+
+  template <typename T, ORDERING ORD, typename ALLOC>
+  MappedMatrix<T,ORD> Matrix<T,ORD,ALLOC>::mmap (const std::string & path, bool writable)
+  {
+    return MappedMatrix<T,ORD> (path, writable);
+  }
+
+}
+
+#endif
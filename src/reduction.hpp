@@ -0,0 +1,477 @@
+#ifndef FILE_REDUCTION
+#define FILE_REDUCTION
+
+#include <cmath>
+#include <complex>
+#include <limits>
+#include <utility>
+#include <vector>
+#include <algorithm>
+#include <atomic>
+#include <type_traits>
+
+#include "vecexpr.hpp"
+#include "simd_functions.hpp"
+#include "taskmanager.hpp"
+
+/*
+  Reductions of vector expressions: dot, Sum, Norm, MaxAbs, MinIndex
+  and MaxIndex. Contiguous float and double expressions are reduced
+  with several independent SIMD accumulators, so the additions do not
+  wait for each other. Long vectors are reduced in pieces on the
+  ASC_HPC workers, and the partial results are combined in a binary tree.
+
+  With FastReduction the pieces depend on the number of threads, so a
+  sum may change in the last bits if the pool changes.
+  DeterministicReduction uses pieces of fixed length and gives the same
+  bits for any number of threads. CompensatedReduction uses the same
+  pieces and adds the rounding errors of all products and additions
+  (TwoSum and FMA), so sums are about as accurate as computed in twice
+  the precision and rounded once. Both are reproducible for the same
+  SIMD width, and only without -ffast-math.
+*/
+
+namespace ASC_bla
+{
+
+  enum REDUCTION { FastReduction, DeterministicReduction, CompensatedReduction };
+
+  namespace reduction_detail
+  {
+    // set from one thread while others reduce, e.g. from Python
+    inline std::atomic<REDUCTION> default_mode { FastReduction };
+
+    // entries from which a reduction is split over the workers
+    constexpr size_t PARALLEL_SIZE = size_t(1) << 15;
+    // length of the pieces of DeterministicReduction
+    constexpr size_t CHUNK = size_t(1) << 13;
+    constexpr size_t ACCUMULATORS = 4;
+
+    template <typename T, typename TE>
+    constexpr bool has_simd = (std::is_same_v<T,double> || std::is_same_v<T,float>)
+      && std::is_same_v<simd_scalar_t<TE>, T>;
+
+    // sum of term(i) for first <= i < next
+    template <typename T, typename F>
+    T sumScalar (size_t first, size_t next, F term)
+    {
+      T part[ACCUMULATORS] { };
+      size_t i = first;
+      for ( ; i+ACCUMULATORS <= next; i += ACCUMULATORS)
+        Unroll<ACCUMULATORS> ([&] (auto k) { part[k] += term(i+k); });
+      for ( ; i < next; i++)
+        part[0] += term(i);
+      return (part[0]+part[1]) + (part[2]+part[3]);
+    }
+
+    /*
+      the same, factors(ST(), i) returns SIMD<T,S> a and b with the terms
+      i ... i+S-1 equal to a*b, for S = SW and S = 1
+    */
+    template <typename T, typename FSIMD, typename F>
+    T sumSIMD (size_t first, size_t next, FSIMD factors, F term)
+    {
+      constexpr size_t SW = SIMD_WIDTH<T>;
+      typedef SIMD<T,SW> ST;
+      if (next-first < SW)
+        return sumScalar<T> (first, next, term);
+
+      ST acc[ACCUMULATORS];
+      for (auto & a : acc) a = ST(T(0));
+      size_t i = first;
+      for ( ; i+ACCUMULATORS*SW <= next; i += ACCUMULATORS*SW)
+        Unroll<ACCUMULATORS> ([&] (auto k)
+        {
+          auto [a, b] = factors (ST(), i+k*SW);
+          acc[k] = FMA (a, b, acc[k]);
+        });
+      for ( ; i+SW <= next; i += SW)
+        {
+          auto [a, b] = factors (ST(), i);
+          acc[0] = FMA (a, b, acc[0]);
+        }
+      return HSum ((acc[0]+acc[1]) + (acc[2]+acc[3])) + sumScalar<T> (i, next, term);
+    }
+
+    // s+c += x, the rounding error of s+x is collected in c (TwoSum)
+    template <typename T>
+    void twoSum (T & s, T & c, T x)
+    {
+      T t = s + x;
+      T z = t - s;
+      c += (s - (t - z)) + (x - z);
+      s = t;
+    }
+
+    /*
+      rounded product a*b, as FMA with zero such that the compiler does
+      not contract it with the following addition (-ffp-contract=fast)
+    */
+    template <typename T, size_t S>
+    SIMD<T,S> product (SIMD<T,S> a, SIMD<T,S> b) { return FMA (a, b, SIMD<T,S>(T(0))); }
+
+    // exact error a*b-p of the rounded product p
+    template <typename T, size_t S>
+    SIMD<T,S> productError (SIMD<T,S> a, SIMD<T,S> b, SIMD<T,S> p) { return FMA (a, b, -p); }
+    template <typename T>
+    SIMD<T,1> productError (SIMD<T,1> a, SIMD<T,1> b, SIMD<T,1> p) { return std::fma (a.val(), b.val(), -p.val()); }
+
+    // sum and collected rounding errors of a piece
+    template <typename T>
+    using compensated_t = std::pair<T,T>;
+
+    template <typename T, typename F>
+    compensated_t<T> sumCompensatedScalar (size_t first, size_t next, F term)
+    {
+      T s[ACCUMULATORS] { }, c[ACCUMULATORS] { };
+      size_t i = first;
+      for ( ; i+ACCUMULATORS <= next; i += ACCUMULATORS)
+        Unroll<ACCUMULATORS> ([&] (auto k) { twoSum (s[k], c[k], term(i+k)); });
+      for ( ; i < next; i++)
+        twoSum (s[0], c[0], term(i));
+      for (size_t k = 1; k < ACCUMULATORS; k++)
+        {
+          twoSum (s[0], c[0], s[k]);
+          c[0] += c[k];
+        }
+      return { s[0], c[0] };
+    }
+
+    /*
+      the products a*b are split into the rounded product and its exact
+      error by FMA, both are summed by TwoSum. The lanes are joined in a
+      fixed order.
+    */
+    template <typename T, typename FSIMD>
+    compensated_t<T> sumCompensatedSIMD (size_t first, size_t next, FSIMD factors)
+    {
+      auto add = [&factors] (auto & s, auto & c, size_t i)
+      {
+        typedef std::decay_t<decltype(s)> ST;
+        auto [a, b] = factors (ST(), i);
+        ST p = product (a, b);
+        twoSum (s, c, p);
+        c = c + productError (a, b, p);
+      };
+
+      constexpr size_t SW = SIMD_WIDTH<T>;
+      typedef SIMD<T,SW> ST;
+      ST s[ACCUMULATORS], c[ACCUMULATORS];
+      for (size_t k = 0; k < ACCUMULATORS; k++)
+        s[k] = c[k] = ST(T(0));
+      size_t i = first;
+      for ( ; i+ACCUMULATORS*SW <= next; i += ACCUMULATORS*SW)
+        Unroll<ACCUMULATORS> ([&] (auto k) { add (s[k], c[k], i+k*SW); });
+
+      SIMD<T,1> s1(T(0)), c1(T(0));
+      for ( ; i < next; i++)
+        add (s1, c1, i);
+      T sum = s1.val(), corr = c1.val();
+      for (size_t k = 0; k < ACCUMULATORS; k++)
+        for (size_t l = 0; l < SW; l++)
+          {
+            twoSum (sum, corr, s[k][l]);
+            corr += c[k][l];
+          }
+      return { sum, corr };
+    }
+
+    /*
+      range(first, next) reduces a piece, combine(a, b) joins the
+      results of two neighbouring pieces
+    */
+    template <typename T, typename FR, typename FC>
+    T reduce (size_t n, REDUCTION mode, FR range, FC combine)
+    {
+      if (n < PARALLEL_SIZE)
+        return range (0, n);
+
+      bool fixed = mode != FastReduction;
+      size_t pieces = fixed ? (n+CHUNK-1) / CHUNK
+        : std::min<size_t> (4*ASC_HPC::NumThreads(), n / CHUNK);
+      auto start = [n, pieces, fixed] (size_t p) -> size_t
+      {
+        if (p == pieces) return n;
+        return fixed ? p*CHUNK : (n*p/pieces) & ~size_t(63);
+      };
+
+      std::vector<T> partial(pieces);
+      int tasks = std::min<size_t> (4*ASC_HPC::NumThreads(), pieces);
+      ASC_HPC::RunParallel (tasks, [&] (int nr, int size)
+      {
+        for (size_t p = pieces*nr/size; p < pieces*(nr+1)/size; p++)
+          partial[p] = range (start(p), start(p+1));
+      });
+
+      for (size_t step = 1; step < pieces; step *= 2)
+        for (size_t p = 0; p+step < pieces; p += 2*step)
+          partial[p] = combine (partial[p], partial[p+step]);
+      return partial[0];
+    }
+
+    template <typename T, bool SIMD_OK, typename FSIMD, typename F>
+    T sum (size_t n, REDUCTION mode, bool contiguous, FSIMD factors, F term)
+    {
+      if (mode == CompensatedReduction)
+        {
+          typedef compensated_t<T> TC;
+          TC sc = reduce<TC> (n, mode, [&] (size_t first, size_t next)
+          {
+            if constexpr (SIMD_OK)
+              if (contiguous)
+                return sumCompensatedSIMD<T> (first, next, factors);
+            return sumCompensatedScalar<T> (first, next, term);
+          }, [] (TC a, TC b)
+          {
+            T c = a.second + b.second;
+            twoSum (a.first, c, b.first);
+            return TC(a.first, c);
+          });
+          return sc.first + sc.second;
+        }
+
+      return reduce<T> (n, mode, [&] (size_t first, size_t next)
+      {
+        if constexpr (SIMD_OK)
+          if (contiguous)
+            return sumSIMD<T> (first, next, factors, term);
+        return sumScalar<T> (first, next, term);
+      }, [] (T a, T b) { return a+b; });
+    }
+
+    template <typename T, size_t S>
+    SIMD<T,S> abs (SIMD<T,S> a) { return Select (a < SIMD<T,S>(T(0)), -a, a); }
+
+    template <bool MAX, typename T, size_t S>
+    SIMD<T,S> better (SIMD<T,S> a, SIMD<T,S> b)
+    {
+      if constexpr (MAX)
+        return Select (b > a, b, a);
+      else
+        return Select (b < a, b, a);
+    }
+
+    /*
+      value and first index of the largest (MAX) or smallest entry in
+      first <= i < next. Blocks are searched for their extreme value by
+      SIMD, only the block holding the result is scanned for the index.
+    */
+    template <bool MAX, typename T, bool SIMD_OK, typename TE>
+    std::pair<T,size_t> extremeRange (const TE & e, size_t first, size_t next)
+    {
+      auto better = [] (T a, T b) { return MAX ? a > b : a < b; };
+      T best = e(first);
+      size_t best_index = first;
+      size_t i = first;
+
+      if constexpr (SIMD_OK)
+        if (e.contiguous())
+          {
+            constexpr size_t SW = SIMD_WIDTH<T>;
+            constexpr size_t BLOCK = 16*ACCUMULATORS*SW;
+            typedef SIMD<T,SW> ST;
+            size_t best_block = next;
+            for ( ; i+BLOCK <= next; i += BLOCK)
+              {
+                ST acc[ACCUMULATORS];
+                Unroll<ACCUMULATORS> ([&] (auto k) { acc[k] = e.template eval_simd<SW>(i+k*SW); });
+                for (size_t j = i+ACCUMULATORS*SW; j < i+BLOCK; j += ACCUMULATORS*SW)
+                  Unroll<ACCUMULATORS> ([&] (auto k)
+                  {
+                    acc[k] = reduction_detail::better<MAX> (acc[k], e.template eval_simd<SW>(j+k*SW));
+                  });
+                ST m = reduction_detail::better<MAX> (reduction_detail::better<MAX> (acc[0], acc[1]),
+                                                      reduction_detail::better<MAX> (acc[2], acc[3]));
+                T block_best = m[0];
+                for (size_t l = 1; l < SW; l++)
+                  if (better (m[l], block_best)) block_best = m[l];
+                if (better (block_best, best))
+                  {
+                    best = block_best;
+                    best_block = i;
+                  }
+              }
+            // entries are compared as computed by eval_simd
+            if (best_block != next)
+              for (size_t j = best_block; ; j += SW)
+                {
+                  ST v = e.template eval_simd<SW>(j);
+                  size_t l = 0;
+                  while (l < SW && !(v[l] == best)) l++;
+                  if (l < SW)
+                    {
+                      best_index = j+l;
+                      break;
+                    }
+                }
+          }
+
+      for ( ; i < next; i++)
+        if (better (e(i), best))
+          {
+            best = e(i);
+            best_index = i;
+          }
+      return { best, best_index };
+    }
+
+    template <bool MAX, typename TE>
+    auto extreme (const TE & e, REDUCTION mode)
+    {
+      typedef std::decay_t<decltype(e(0))> T;
+      typedef std::pair<T,size_t> TP;
+      assert (e.size() > 0);
+      return reduce<TP> (e.size(), mode, [&] (size_t first, size_t next)
+      {
+        return extremeRange<MAX, T, has_simd<T,TE>> (e, first, next);
+      }, [] (TP a, TP b)
+      {
+        return (MAX ? b.first > a.first : b.first < a.first) ? b : a;
+      });
+    }
+  }
+
+  // mode of reductions called without one
+  inline REDUCTION ReductionMode() { return reduction_detail::default_mode.load(std::memory_order_relaxed); }
+  inline void SetReductionMode (REDUCTION mode) { reduction_detail::default_mode.store(mode, std::memory_order_relaxed); }
+
+
+  // **************** dot product of two vectors *****************
+
+  template <typename TA, typename TB>
+  auto dot (const VecExpr<TA> & a, const VecExpr<TB> & b, REDUCTION mode = ReductionMode())
+  {
+    assert (a.size() == b.size());
+    const TA & ea = a.derived();
+    const TB & eb = b.derived();
+
+    using elemtypeA = typename std::invoke_result<TA,size_t>::type;
+    using elemtypeB = typename std::invoke_result<TB,size_t>::type;
+    using TSUM = decltype(std::declval<elemtypeA>()*std::declval<elemtypeB>());
+
+    return reduction_detail::sum<TSUM, reduction_detail::has_simd<TSUM,TA> && reduction_detail::has_simd<TSUM,TB>>
+      (ea.size(), mode, ea.contiguous() && eb.contiguous(),
+       [&] (auto simd, size_t i)
+       {
+         constexpr size_t S = decltype(simd)::size();
+         return std::pair (ea.template eval_simd<S>(i), eb.template eval_simd<S>(i));
+       },
+       [&] (size_t i) { return ea(i)*eb(i); });
+  }
+
+  // **************** sum of the entries *****************
+
+  template <typename TV>
+  auto Sum (const VecExpr<TV> & v, REDUCTION mode = ReductionMode())
+  {
+    const TV & e = v.derived();
+    typedef std::decay_t<decltype(e(0))> T;
+    return reduction_detail::sum<T, reduction_detail::has_simd<T,TV>>
+      (e.size(), mode, e.contiguous(),
+       [&] (auto simd, size_t i)
+       {
+         typedef decltype(simd) ST;
+         return std::pair (e.template eval_simd<ST::size()>(i), ST(T(1)));
+       },
+       [&] (size_t i) { return e(i); });
+  }
+
+  // **************** largest absolute value *****************
+
+  template <typename TV>
+  auto MaxAbs (const VecExpr<TV> & v, REDUCTION mode = ReductionMode())
+  {
+    const TV & e = v.derived();
+    typedef std::decay_t<decltype(e(0))> T;
+    typedef decltype(std::abs(e(0))) TR;
+    return reduction_detail::reduce<TR> (e.size(), mode, [&] (size_t first, size_t next)
+    {
+      TR m(0);
+      size_t i = first;
+      if constexpr (reduction_detail::has_simd<T,TV>)
+        if (e.contiguous())
+          {
+            using namespace reduction_detail;
+            constexpr size_t SW = SIMD_WIDTH<T>;
+            SIMD<T,SW> acc[ACCUMULATORS];
+            for (auto & a : acc) a = SIMD<T,SW>(T(0));
+            for ( ; i+ACCUMULATORS*SW <= next; i += ACCUMULATORS*SW)
+              Unroll<ACCUMULATORS> ([&] (auto k)
+              {
+                acc[k] = better<true> (acc[k], reduction_detail::abs (e.template eval_simd<SW>(i+k*SW)));
+              });
+            auto am = better<true> (better<true> (acc[0], acc[1]), better<true> (acc[2], acc[3]));
+            for (size_t l = 0; l < SW; l++)
+              m = std::max (m, am[l]);
+          }
+      for ( ; i < next; i++)
+        m = std::max (m, TR(std::abs(e(i))));
+      return m;
+    }, [] (TR a, TR b) { return std::max(a, b); });
+  }
+
+  // **************** Euclidean norm *****************
+
+  /*
+    The squares are summed directly. Only if the sum overflows or may
+    have lost entries to underflow, the vector is summed again, scaled
+    by a power of two close to 1/MaxAbs(v).
+  */
+  template <typename TV>
+  auto Norm (const VecExpr<TV> & v, REDUCTION mode = ReductionMode())
+  {
+    const TV & e = v.derived();
+    typedef std::decay_t<decltype(e(0))> T;
+    typedef decltype(std::abs(e(0))) TR;
+    constexpr bool simd = reduction_detail::has_simd<T,TV>;
+    size_t n = e.size();
+
+    TR sum = reduction_detail::sum<TR, simd>
+      (n, mode, e.contiguous(),
+       [&] (auto simd, size_t i)
+       {
+         auto x = e.template eval_simd<decltype(simd)::size()>(i);
+         return std::pair (x, x);
+       },
+       [&] (size_t i) { return TR(std::norm(e(i))); });
+
+    if (std::isfinite(sum) && sum >= n * (std::numeric_limits<TR>::min() / std::numeric_limits<TR>::epsilon()))
+      return std::sqrt(sum);
+
+    TR m = MaxAbs (v, mode);
+    if (m == TR(0) || !std::isfinite(m))
+      return m;
+    // two factors, 1/m of a subnormal m does not fit into one
+    int exp = -std::ilogb(m);
+    TR s1 = std::ldexp(TR(1), exp/2), s2 = std::ldexp(TR(1), exp-exp/2);
+    TR scaled = reduction_detail::sum<TR, simd>
+      (n, mode, e.contiguous(),
+       [&] (auto simd, size_t i)
+       {
+         typedef decltype(simd) ST;
+         auto x = ST(s2) * (ST(s1) * e.template eval_simd<ST::size()>(i));
+         return std::pair (x, x);
+       },
+       [&] (size_t i) { return TR(std::norm(s2 * (s1 * e(i)))); });
+    return std::ldexp (std::sqrt(scaled), -exp);
+  }
+
+  // **************** extreme entries with their index *****************
+
+  // (value, index) of the smallest entry, the first one if it occurs repeatedly
+  template <typename TV>
+  auto MinIndex (const VecExpr<TV> & v, REDUCTION mode = ReductionMode())
+  {
+    return reduction_detail::extreme<false> (v.derived(), mode);
+  }
+
+  // (value, index) of the largest entry, the first one if it occurs repeatedly
+  template <typename TV>
+  auto MaxIndex (const VecExpr<TV> & v, REDUCTION mode = ReductionMode())
+  {
+    return reduction_detail::extreme<true> (v.derived(), mode);
+  }
+
+}
+
+#endif
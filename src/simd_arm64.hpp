@@ -0,0 +1,230 @@
+#ifndef FILE_SIMD_ARM64
+#define FILE_SIMD_ARM64
+
+// NEON specializations for aarch64, included from simd_functions.hpp
+
+#include <arm_neon.h>
+
+namespace ASC_bla
+{
+
+  // ***************** masks *****************
+
+  template <>
+  class SIMD<mask64,2>
+  {
+    uint64x2_t m_mask;
+  public:
+    SIMD() = default;
+    SIMD (uint64x2_t mask) : m_mask(mask) { }
+    SIMD (mask64 m) : m_mask(vdupq_n_u64(uint64_t(m.value()))) { }
+
+    static SIMD mask_first (size_t n)
+    {
+      uint64_t index[2] = { 0, 1 };
+      return vcltq_u64(vld1q_u64(index), vdupq_n_u64(n));
+    }
+
+    static constexpr size_t size() { return 2; }
+    uint64x2_t val() const { return m_mask; }
+    mask64 operator[] (size_t i) const { return ((i == 0) ? vgetq_lane_u64(m_mask, 0) : vgetq_lane_u64(m_mask, 1)) != 0; }
+  };
+
+  template <>
+  class SIMD<mask32,4>
+  {
+    uint32x4_t m_mask;
+  public:
+    SIMD() = default;
+    SIMD (uint32x4_t mask) : m_mask(mask) { }
+    SIMD (mask32 m) : m_mask(vdupq_n_u32(uint32_t(m.value()))) { }
+
+    static SIMD mask_first (size_t n)
+    {
+      uint32_t index[4] = { 0, 1, 2, 3 };
+      return vcltq_u32(vld1q_u32(index), vdupq_n_u32(n < 4 ? n : 4));
+    }
+
+    static constexpr size_t size() { return 4; }
+    uint32x4_t val() const { return m_mask; }
+    mask32 operator[] (size_t i) const
+    {
+      uint32_t tmp[4];
+      vst1q_u32(tmp, m_mask);
+      return tmp[i] != 0;
+    }
+  };
+
+  inline SIMD<mask64,2> operator&& (SIMD<mask64,2> a, SIMD<mask64,2> b) { return vandq_u64(a.val(), b.val()); }
+  inline SIMD<mask64,2> operator|| (SIMD<mask64,2> a, SIMD<mask64,2> b) { return vorrq_u64(a.val(), b.val()); }
+  inline SIMD<mask64,2> operator! (SIMD<mask64,2> a) { return veorq_u64(a.val(), vdupq_n_u64(~uint64_t(0))); }
+  inline SIMD<mask32,4> operator&& (SIMD<mask32,4> a, SIMD<mask32,4> b) { return vandq_u32(a.val(), b.val()); }
+  inline SIMD<mask32,4> operator|| (SIMD<mask32,4> a, SIMD<mask32,4> b) { return vorrq_u32(a.val(), b.val()); }
+  inline SIMD<mask32,4> operator! (SIMD<mask32,4> a) { return vmvnq_u32(a.val()); }
+
+
+  // ***************** double *****************
+
+  template <>
+  class SIMD<double,2>
+  {
+    float64x2_t m_val;
+  public:
+    SIMD() = default;
+    SIMD (float64x2_t val) : m_val(val) { }
+    SIMD (double val) : m_val(vdupq_n_f64(val)) { }
+    SIMD (SIMD<double,1> lo, SIMD<double,1> hi) : m_val(vcombine_f64(vdup_n_f64(lo.val()), vdup_n_f64(hi.val()))) { }
+    explicit SIMD (const double * ptr) : m_val(vld1q_f64(ptr)) { }
+    // NEON has no masked loads, only touch the active lanes
+    SIMD (const double * ptr, SIMD<mask64,2> mask)
+      : SIMD(bool(mask[0]) ? ptr[0] : 0.0, bool(mask[1]) ? ptr[1] : 0.0) { }
+
+    static SIMD load_aligned (const double * ptr) { return vld1q_f64(ptr); }
+
+    static constexpr size_t size() { return 2; }
+    float64x2_t val() const { return m_val; }
+    SIMD<double,1> lo() const { return vgetq_lane_f64(m_val, 0); }
+    SIMD<double,1> hi() const { return vgetq_lane_f64(m_val, 1); }
+    double operator[] (size_t i) const { return (i == 0) ? vgetq_lane_f64(m_val, 0) : vgetq_lane_f64(m_val, 1); }
+
+    void store (double * ptr) const { vst1q_f64(ptr, m_val); }
+    void store_aligned (double * ptr) const { vst1q_f64(ptr, m_val); }
+    void store (double * ptr, SIMD<mask64,2> mask) const
+    {
+      if (bool(mask[0])) ptr[0] = vgetq_lane_f64(m_val, 0);
+      if (bool(mask[1])) ptr[1] = vgetq_lane_f64(m_val, 1);
+    }
+  };
+
+  inline SIMD<double,2> operator+ (SIMD<double,2> a, SIMD<double,2> b) { return vaddq_f64(a.val(), b.val()); }
+  inline SIMD<double,2> operator- (SIMD<double,2> a, SIMD<double,2> b) { return vsubq_f64(a.val(), b.val()); }
+  inline SIMD<double,2> operator* (SIMD<double,2> a, SIMD<double,2> b) { return vmulq_f64(a.val(), b.val()); }
+  inline SIMD<double,2> operator/ (SIMD<double,2> a, SIMD<double,2> b) { return vdivq_f64(a.val(), b.val()); }
+  inline SIMD<double,2> operator- (SIMD<double,2> a) { return vnegq_f64(a.val()); }
+  inline SIMD<double,2> FMA (SIMD<double,2> a, SIMD<double,2> b, SIMD<double,2> c) { return vfmaq_f64(c.val(), a.val(), b.val()); }
+  inline double HSum (SIMD<double,2> a) { return vaddvq_f64(a.val()); }
+
+  inline SIMD<double,2> Select (SIMD<mask64,2> mask, SIMD<double,2> a, SIMD<double,2> b)
+  { return vbslq_f64(mask.val(), a.val(), b.val()); }
+
+
+  // ***************** float *****************
+
+  template <>
+  class SIMD<float,4>
+  {
+    float32x4_t m_val;
+  public:
+    SIMD() = default;
+    SIMD (float32x4_t val) : m_val(val) { }
+    SIMD (float val) : m_val(vdupq_n_f32(val)) { }
+    explicit SIMD (const float * ptr) : m_val(vld1q_f32(ptr)) { }
+    SIMD (const float * ptr, SIMD<mask32,4> mask)
+    {
+      float tmp[4];
+      for (size_t i = 0; i < 4; i++)
+        tmp[i] = bool(mask[i]) ? ptr[i] : 0.0f;
+      m_val = vld1q_f32(tmp);
+    }
+
+    static SIMD load_aligned (const float * ptr) { return vld1q_f32(ptr); }
+
+    static constexpr size_t size() { return 4; }
+    float32x4_t val() const { return m_val; }
+    float operator[] (size_t i) const
+    {
+      float tmp[4];
+      vst1q_f32(tmp, m_val);
+      return tmp[i];
+    }
+
+    void store (float * ptr) const { vst1q_f32(ptr, m_val); }
+    void store_aligned (float * ptr) const { vst1q_f32(ptr, m_val); }
+    void store (float * ptr, SIMD<mask32,4> mask) const
+    {
+      float tmp[4];
+      vst1q_f32(tmp, m_val);
+      for (size_t i = 0; i < 4; i++)
+        if (bool(mask[i])) ptr[i] = tmp[i];
+    }
+  };
+
+  inline SIMD<float,4> operator+ (SIMD<float,4> a, SIMD<float,4> b) { return vaddq_f32(a.val(), b.val()); }
+  inline SIMD<float,4> operator- (SIMD<float,4> a, SIMD<float,4> b) { return vsubq_f32(a.val(), b.val()); }
+  inline SIMD<float,4> operator* (SIMD<float,4> a, SIMD<float,4> b) { return vmulq_f32(a.val(), b.val()); }
+  inline SIMD<float,4> operator/ (SIMD<float,4> a, SIMD<float,4> b) { return vdivq_f32(a.val(), b.val()); }
+  inline SIMD<float,4> operator- (SIMD<float,4> a) { return vnegq_f32(a.val()); }
+  inline SIMD<float,4> FMA (SIMD<float,4> a, SIMD<float,4> b, SIMD<float,4> c) { return vfmaq_f32(c.val(), a.val(), b.val()); }
+  inline float HSum (SIMD<float,4> a) { return vaddvq_f32(a.val()); }
+
+  inline SIMD<float,4> Select (SIMD<mask32,4> mask, SIMD<float,4> a, SIMD<float,4> b)
+  { return vbslq_f32(mask.val(), a.val(), b.val()); }
+
+  inline SIMD<mask64,2> operator< (SIMD<double,2> a, SIMD<double,2> b) { return vcltq_f64(a.val(), b.val()); }
+  inline SIMD<mask64,2> operator<= (SIMD<double,2> a, SIMD<double,2> b) { return vcleq_f64(a.val(), b.val()); }
+  inline SIMD<mask64,2> operator> (SIMD<double,2> a, SIMD<double,2> b) { return vcgtq_f64(a.val(), b.val()); }
+  inline SIMD<mask64,2> operator>= (SIMD<double,2> a, SIMD<double,2> b) { return vcgeq_f64(a.val(), b.val()); }
+  inline SIMD<mask64,2> operator== (SIMD<double,2> a, SIMD<double,2> b) { return vceqq_f64(a.val(), b.val()); }
+  inline SIMD<mask64,2> operator!= (SIMD<double,2> a, SIMD<double,2> b) { return !(a == b); }
+
+  inline SIMD<mask32,4> operator< (SIMD<float,4> a, SIMD<float,4> b) { return vcltq_f32(a.val(), b.val()); }
+  inline SIMD<mask32,4> operator<= (SIMD<float,4> a, SIMD<float,4> b) { return vcleq_f32(a.val(), b.val()); }
+  inline SIMD<mask32,4> operator> (SIMD<float,4> a, SIMD<float,4> b) { return vcgtq_f32(a.val(), b.val()); }
+  inline SIMD<mask32,4> operator>= (SIMD<float,4> a, SIMD<float,4> b) { return vcgeq_f32(a.val(), b.val()); }
+  inline SIMD<mask32,4> operator== (SIMD<float,4> a, SIMD<float,4> b) { return vceqq_f32(a.val(), b.val()); }
+  inline SIMD<mask32,4> operator!= (SIMD<float,4> a, SIMD<float,4> b) { return vmvnq_u32(vceqq_f32(a.val(), b.val())); }
+
+
+  // ***************** int64_t *****************
+
+  template <>
+  class SIMD<int64_t,2>
+  {
+    int64x2_t m_val;
+  public:
+    SIMD() = default;
+    SIMD (int64x2_t val) : m_val(val) { }
+    SIMD (int64_t val) : m_val(vdupq_n_s64(val)) { }
+    SIMD (SIMD<int64_t,1> lo, SIMD<int64_t,1> hi) : m_val(vcombine_s64(vdup_n_s64(lo.val()), vdup_n_s64(hi.val()))) { }
+    explicit SIMD (const int64_t * ptr) : m_val(vld1q_s64(ptr)) { }
+    SIMD (const int64_t * ptr, SIMD<mask64,2> mask)
+      : SIMD(bool(mask[0]) ? ptr[0] : 0, bool(mask[1]) ? ptr[1] : 0) { }
+
+    static SIMD load_aligned (const int64_t * ptr) { return vld1q_s64(ptr); }
+
+    static constexpr size_t size() { return 2; }
+    int64x2_t val() const { return m_val; }
+    SIMD<int64_t,1> lo() const { return vgetq_lane_s64(m_val, 0); }
+    SIMD<int64_t,1> hi() const { return vgetq_lane_s64(m_val, 1); }
+    int64_t operator[] (size_t i) const { return (i == 0) ? vgetq_lane_s64(m_val, 0) : vgetq_lane_s64(m_val, 1); }
+
+    void store (int64_t * ptr) const { vst1q_s64(ptr, m_val); }
+    void store_aligned (int64_t * ptr) const { vst1q_s64(ptr, m_val); }
+    void store (int64_t * ptr, SIMD<mask64,2> mask) const
+    {
+      if (bool(mask[0])) ptr[0] = vgetq_lane_s64(m_val, 0);
+      if (bool(mask[1])) ptr[1] = vgetq_lane_s64(m_val, 1);
+    }
+  };
+
+  inline SIMD<int64_t,2> operator+ (SIMD<int64_t,2> a, SIMD<int64_t,2> b) { return vaddq_s64(a.val(), b.val()); }
+  inline SIMD<int64_t,2> operator- (SIMD<int64_t,2> a, SIMD<int64_t,2> b) { return vsubq_s64(a.val(), b.val()); }
+  inline SIMD<int64_t,2> operator- (SIMD<int64_t,2> a) { return vnegq_s64(a.val()); }
+  // no 64-bit integer multiply in NEON
+  inline SIMD<int64_t,2> operator* (SIMD<int64_t,2> a, SIMD<int64_t,2> b)
+  { return SIMD<int64_t,2>(SIMD<int64_t,1>(a[0]*b[0]), SIMD<int64_t,1>(a[1]*b[1])); }
+  inline SIMD<int64_t,2> FMA (SIMD<int64_t,2> a, SIMD<int64_t,2> b, SIMD<int64_t,2> c) { return a*b+c; }
+  inline int64_t HSum (SIMD<int64_t,2> a) { return vaddvq_s64(a.val()); }
+
+  inline SIMD<int64_t,2> Select (SIMD<mask64,2> mask, SIMD<int64_t,2> a, SIMD<int64_t,2> b)
+  { return vbslq_s64(mask.val(), a.val(), b.val()); }
+
+  inline SIMD<mask64,2> operator< (SIMD<int64_t,2> a, SIMD<int64_t,2> b) { return vcltq_s64(a.val(), b.val()); }
+  inline SIMD<mask64,2> operator<= (SIMD<int64_t,2> a, SIMD<int64_t,2> b) { return vcleq_s64(a.val(), b.val()); }
+  inline SIMD<mask64,2> operator> (SIMD<int64_t,2> a, SIMD<int64_t,2> b) { return vcgtq_s64(a.val(), b.val()); }
+  inline SIMD<mask64,2> operator>= (SIMD<int64_t,2> a, SIMD<int64_t,2> b) { return vcgeq_s64(a.val(), b.val()); }
+  inline SIMD<mask64,2> operator== (SIMD<int64_t,2> a, SIMD<int64_t,2> b) { return vceqq_s64(a.val(), b.val()); }
+  inline SIMD<mask64,2> operator!= (SIMD<int64_t,2> a, SIMD<int64_t,2> b) { return !(a == b); }
+}
+
+#endif
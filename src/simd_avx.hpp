@@ -0,0 +1,395 @@
+#ifndef FILE_SIMD_AVX
+#define FILE_SIMD_AVX
+
+// AVX2 + FMA specializations, included from simd_functions.hpp
+
+#include <immintrin.h>
+
+namespace ASC_bla
+{
+
+  // ***************** masks *****************
+
+  template <>
+  class SIMD<mask64,4>
+  {
+    __m256i m_mask;
+  public:
+    SIMD() = default;
+    SIMD (__m256i mask) : m_mask(mask) { }
+    SIMD (mask64 m) : m_mask(_mm256_set1_epi64x(m.value())) { }
+    SIMD (SIMD<mask64,2> lo, SIMD<mask64,2> hi);
+
+    static SIMD mask_first (size_t n)
+    {
+      int64_t nn = n < 4 ? n : 4;
+      return _mm256_cmpgt_epi64(_mm256_set1_epi64x(nn), _mm256_set_epi64x(3, 2, 1, 0));
+    }
+
+    static constexpr size_t size() { return 4; }
+    __m256i val() const { return m_mask; }
+    SIMD<mask64,2> lo() const;
+    SIMD<mask64,2> hi() const;
+    mask64 operator[] (size_t i) const
+    {
+      alignas(32) int64_t tmp[4];
+      _mm256_store_si256((__m256i*)tmp, m_mask);
+      return tmp[i] != 0;
+    }
+  };
+
+  template <>
+  class SIMD<mask64,2>
+  {
+    __m128i m_mask;
+  public:
+    SIMD() = default;
+    SIMD (__m128i mask) : m_mask(mask) { }
+    SIMD (mask64 m) : m_mask(_mm_set1_epi64x(m.value())) { }
+
+    static SIMD mask_first (size_t n)
+    {
+      int64_t nn = n < 2 ? n : 2;
+      return _mm_cmpgt_epi64(_mm_set1_epi64x(nn), _mm_set_epi64x(1, 0));
+    }
+
+    static constexpr size_t size() { return 2; }
+    __m128i val() const { return m_mask; }
+    mask64 operator[] (size_t i) const
+    {
+      alignas(16) int64_t tmp[2];
+      _mm_store_si128((__m128i*)tmp, m_mask);
+      return tmp[i] != 0;
+    }
+  };
+
+  inline SIMD<mask64,4>::SIMD (SIMD<mask64,2> lo, SIMD<mask64,2> hi)
+    : m_mask(_mm256_set_m128i(hi.val(), lo.val())) { }
+  inline SIMD<mask64,2> SIMD<mask64,4>::lo() const { return _mm256_castsi256_si128(m_mask); }
+  inline SIMD<mask64,2> SIMD<mask64,4>::hi() const { return _mm256_extracti128_si256(m_mask, 1); }
+
+  template <>
+  class SIMD<mask32,8>
+  {
+    __m256i m_mask;
+  public:
+    SIMD() = default;
+    SIMD (__m256i mask) : m_mask(mask) { }
+    SIMD (mask32 m) : m_mask(_mm256_set1_epi32(m.value())) { }
+
+    static SIMD mask_first (size_t n)
+    {
+      int32_t nn = n < 8 ? n : 8;
+      return _mm256_cmpgt_epi32(_mm256_set1_epi32(nn), _mm256_set_epi32(7, 6, 5, 4, 3, 2, 1, 0));
+    }
+
+    static constexpr size_t size() { return 8; }
+    __m256i val() const { return m_mask; }
+    mask32 operator[] (size_t i) const
+    {
+      alignas(32) int32_t tmp[8];
+      _mm256_store_si256((__m256i*)tmp, m_mask);
+      return tmp[i] != 0;
+    }
+  };
+
+  template <>
+  class SIMD<mask32,4>
+  {
+    __m128i m_mask;
+  public:
+    SIMD() = default;
+    SIMD (__m128i mask) : m_mask(mask) { }
+    SIMD (mask32 m) : m_mask(_mm_set1_epi32(m.value())) { }
+
+    static SIMD mask_first (size_t n)
+    {
+      int32_t nn = n < 4 ? n : 4;
+      return _mm_cmpgt_epi32(_mm_set1_epi32(nn), _mm_set_epi32(3, 2, 1, 0));
+    }
+
+    static constexpr size_t size() { return 4; }
+    __m128i val() const { return m_mask; }
+    mask32 operator[] (size_t i) const
+    {
+      alignas(16) int32_t tmp[4];
+      _mm_store_si128((__m128i*)tmp, m_mask);
+      return tmp[i] != 0;
+    }
+  };
+
+  inline SIMD<mask64,4> operator&& (SIMD<mask64,4> a, SIMD<mask64,4> b) { return _mm256_and_si256(a.val(), b.val()); }
+  inline SIMD<mask64,4> operator|| (SIMD<mask64,4> a, SIMD<mask64,4> b) { return _mm256_or_si256(a.val(), b.val()); }
+  inline SIMD<mask64,4> operator! (SIMD<mask64,4> a) { return _mm256_xor_si256(a.val(), _mm256_set1_epi64x(-1)); }
+  inline SIMD<mask64,2> operator&& (SIMD<mask64,2> a, SIMD<mask64,2> b) { return _mm_and_si128(a.val(), b.val()); }
+  inline SIMD<mask64,2> operator|| (SIMD<mask64,2> a, SIMD<mask64,2> b) { return _mm_or_si128(a.val(), b.val()); }
+  inline SIMD<mask64,2> operator! (SIMD<mask64,2> a) { return _mm_xor_si128(a.val(), _mm_set1_epi64x(-1)); }
+  inline SIMD<mask32,8> operator&& (SIMD<mask32,8> a, SIMD<mask32,8> b) { return _mm256_and_si256(a.val(), b.val()); }
+  inline SIMD<mask32,8> operator|| (SIMD<mask32,8> a, SIMD<mask32,8> b) { return _mm256_or_si256(a.val(), b.val()); }
+  inline SIMD<mask32,8> operator! (SIMD<mask32,8> a) { return _mm256_xor_si256(a.val(), _mm256_set1_epi32(-1)); }
+  inline SIMD<mask32,4> operator&& (SIMD<mask32,4> a, SIMD<mask32,4> b) { return _mm_and_si128(a.val(), b.val()); }
+  inline SIMD<mask32,4> operator|| (SIMD<mask32,4> a, SIMD<mask32,4> b) { return _mm_or_si128(a.val(), b.val()); }
+  inline SIMD<mask32,4> operator! (SIMD<mask32,4> a) { return _mm_xor_si128(a.val(), _mm_set1_epi32(-1)); }
+
+
+  // ***************** double *****************
+
+  template <>
+  class SIMD<double,4>
+  {
+    __m256d m_val;
+  public:
+    SIMD() = default;
+    SIMD (__m256d val) : m_val(val) { }
+    SIMD (double val) : m_val(_mm256_set1_pd(val)) { }
+    SIMD (SIMD<double,2> lo, SIMD<double,2> hi);
+    explicit SIMD (const double * ptr) : m_val(_mm256_loadu_pd(ptr)) { }
+    SIMD (const double * ptr, SIMD<mask64,4> mask) : m_val(_mm256_maskload_pd(ptr, mask.val())) { }
+
+    static SIMD load_aligned (const double * ptr) { return _mm256_load_pd(ptr); }
+
+    static constexpr size_t size() { return 4; }
+    __m256d val() const { return m_val; }
+    SIMD<double,2> lo() const;
+    SIMD<double,2> hi() const;
+    double operator[] (size_t i) const
+    {
+      alignas(32) double tmp[4];
+      _mm256_store_pd(tmp, m_val);
+      return tmp[i];
+    }
+
+    void store (double * ptr) const { _mm256_storeu_pd(ptr, m_val); }
+    void store_aligned (double * ptr) const { _mm256_store_pd(ptr, m_val); }
+    void store (double * ptr, SIMD<mask64,4> mask) const { _mm256_maskstore_pd(ptr, mask.val(), m_val); }
+  };
+
+  template <>
+  class SIMD<double,2>
+  {
+    __m128d m_val;
+  public:
+    SIMD() = default;
+    SIMD (__m128d val) : m_val(val) { }
+    SIMD (double val) : m_val(_mm_set1_pd(val)) { }
+    SIMD (SIMD<double,1> lo, SIMD<double,1> hi) : m_val(_mm_set_pd(hi.val(), lo.val())) { }
+    explicit SIMD (const double * ptr) : m_val(_mm_loadu_pd(ptr)) { }
+    SIMD (const double * ptr, SIMD<mask64,2> mask) : m_val(_mm_maskload_pd(ptr, mask.val())) { }
+
+    static SIMD load_aligned (const double * ptr) { return _mm_load_pd(ptr); }
+
+    static constexpr size_t size() { return 2; }
+    __m128d val() const { return m_val; }
+    SIMD<double,1> lo() const { return _mm_cvtsd_f64(m_val); }
+    SIMD<double,1> hi() const { return _mm_cvtsd_f64(_mm_unpackhi_pd(m_val, m_val)); }
+    double operator[] (size_t i) const
+    {
+      alignas(16) double tmp[2];
+      _mm_store_pd(tmp, m_val);
+      return tmp[i];
+    }
+
+    void store (double * ptr) const { _mm_storeu_pd(ptr, m_val); }
+    void store_aligned (double * ptr) const { _mm_store_pd(ptr, m_val); }
+    void store (double * ptr, SIMD<mask64,2> mask) const { _mm_maskstore_pd(ptr, mask.val(), m_val); }
+  };
+
+  inline SIMD<double,4>::SIMD (SIMD<double,2> lo, SIMD<double,2> hi)
+    : m_val(_mm256_set_m128d(hi.val(), lo.val())) { }
+  inline SIMD<double,2> SIMD<double,4>::lo() const { return _mm256_castpd256_pd128(m_val); }
+  inline SIMD<double,2> SIMD<double,4>::hi() const { return _mm256_extractf128_pd(m_val, 1); }
+
+  inline SIMD<double,4> operator+ (SIMD<double,4> a, SIMD<double,4> b) { return _mm256_add_pd(a.val(), b.val()); }
+  inline SIMD<double,4> operator- (SIMD<double,4> a, SIMD<double,4> b) { return _mm256_sub_pd(a.val(), b.val()); }
+  inline SIMD<double,4> operator* (SIMD<double,4> a, SIMD<double,4> b) { return _mm256_mul_pd(a.val(), b.val()); }
+  inline SIMD<double,4> operator/ (SIMD<double,4> a, SIMD<double,4> b) { return _mm256_div_pd(a.val(), b.val()); }
+  inline SIMD<double,4> operator- (SIMD<double,4> a) { return _mm256_xor_pd(a.val(), _mm256_set1_pd(-0.0)); }
+  inline SIMD<double,4> FMA (SIMD<double,4> a, SIMD<double,4> b, SIMD<double,4> c) { return _mm256_fmadd_pd(a.val(), b.val(), c.val()); }
+
+  inline double HSum (SIMD<double,4> a)
+  {
+    __m128d s = _mm_add_pd(_mm256_castpd256_pd128(a.val()), _mm256_extractf128_pd(a.val(), 1));
+    return _mm_cvtsd_f64(_mm_add_sd(s, _mm_unpackhi_pd(s, s)));
+  }
+
+  inline SIMD<double,2> operator+ (SIMD<double,2> a, SIMD<double,2> b) { return _mm_add_pd(a.val(), b.val()); }
+  inline SIMD<double,2> operator- (SIMD<double,2> a, SIMD<double,2> b) { return _mm_sub_pd(a.val(), b.val()); }
+  inline SIMD<double,2> operator* (SIMD<double,2> a, SIMD<double,2> b) { return _mm_mul_pd(a.val(), b.val()); }
+  inline SIMD<double,2> operator/ (SIMD<double,2> a, SIMD<double,2> b) { return _mm_div_pd(a.val(), b.val()); }
+  inline SIMD<double,2> operator- (SIMD<double,2> a) { return _mm_xor_pd(a.val(), _mm_set1_pd(-0.0)); }
+  inline SIMD<double,2> FMA (SIMD<double,2> a, SIMD<double,2> b, SIMD<double,2> c) { return _mm_fmadd_pd(a.val(), b.val(), c.val()); }
+  inline double HSum (SIMD<double,2> a) { return _mm_cvtsd_f64(_mm_add_sd(a.val(), _mm_unpackhi_pd(a.val(), a.val()))); }
+
+#define ASC_SIMD_AVX_COMPARE(OP, PRED)                                  \
+  inline SIMD<mask64,4> operator OP (SIMD<double,4> a, SIMD<double,4> b) \
+  { return _mm256_castpd_si256(_mm256_cmp_pd(a.val(), b.val(), PRED)); } \
+  inline SIMD<mask64,2> operator OP (SIMD<double,2> a, SIMD<double,2> b) \
+  { return _mm_castpd_si128(_mm_cmp_pd(a.val(), b.val(), PRED)); }       \
+  inline SIMD<mask32,8> operator OP (SIMD<float,8> a, SIMD<float,8> b)   \
+  { return _mm256_castps_si256(_mm256_cmp_ps(a.val(), b.val(), PRED)); } \
+  inline SIMD<mask32,4> operator OP (SIMD<float,4> a, SIMD<float,4> b)   \
+  { return _mm_castps_si128(_mm_cmp_ps(a.val(), b.val(), PRED)); }
+
+  inline SIMD<double,4> Select (SIMD<mask64,4> mask, SIMD<double,4> a, SIMD<double,4> b)
+  { return _mm256_blendv_pd(b.val(), a.val(), _mm256_castsi256_pd(mask.val())); }
+  inline SIMD<double,2> Select (SIMD<mask64,2> mask, SIMD<double,2> a, SIMD<double,2> b)
+  { return _mm_blendv_pd(b.val(), a.val(), _mm_castsi128_pd(mask.val())); }
+
+
+  // ***************** float *****************
+
+  template <>
+  class SIMD<float,8>
+  {
+    __m256 m_val;
+  public:
+    SIMD() = default;
+    SIMD (__m256 val) : m_val(val) { }
+    SIMD (float val) : m_val(_mm256_set1_ps(val)) { }
+    SIMD (SIMD<float,4> lo, SIMD<float,4> hi);
+    explicit SIMD (const float * ptr) : m_val(_mm256_loadu_ps(ptr)) { }
+    SIMD (const float * ptr, SIMD<mask32,8> mask) : m_val(_mm256_maskload_ps(ptr, mask.val())) { }
+
+    static SIMD load_aligned (const float * ptr) { return _mm256_load_ps(ptr); }
+
+    static constexpr size_t size() { return 8; }
+    __m256 val() const { return m_val; }
+    SIMD<float,4> lo() const;
+    SIMD<float,4> hi() const;
+    float operator[] (size_t i) const
+    {
+      alignas(32) float tmp[8];
+      _mm256_store_ps(tmp, m_val);
+      return tmp[i];
+    }
+
+    void store (float * ptr) const { _mm256_storeu_ps(ptr, m_val); }
+    void store_aligned (float * ptr) const { _mm256_store_ps(ptr, m_val); }
+    void store (float * ptr, SIMD<mask32,8> mask) const { _mm256_maskstore_ps(ptr, mask.val(), m_val); }
+  };
+
+  template <>
+  class SIMD<float,4>
+  {
+    __m128 m_val;
+  public:
+    SIMD() = default;
+    SIMD (__m128 val) : m_val(val) { }
+    SIMD (float val) : m_val(_mm_set1_ps(val)) { }
+    explicit SIMD (const float * ptr) : m_val(_mm_loadu_ps(ptr)) { }
+    SIMD (const float * ptr, SIMD<mask32,4> mask) : m_val(_mm_maskload_ps(ptr, mask.val())) { }
+
+    static SIMD load_aligned (const float * ptr) { return _mm_load_ps(ptr); }
+
+    static constexpr size_t size() { return 4; }
+    __m128 val() const { return m_val; }
+    float operator[] (size_t i) const
+    {
+      alignas(16) float tmp[4];
+      _mm_store_ps(tmp, m_val);
+      return tmp[i];
+    }
+
+    void store (float * ptr) const { _mm_storeu_ps(ptr, m_val); }
+    void store_aligned (float * ptr) const { _mm_store_ps(ptr, m_val); }
+    void store (float * ptr, SIMD<mask32,4> mask) const { _mm_maskstore_ps(ptr, mask.val(), m_val); }
+  };
+
+  inline SIMD<float,8>::SIMD (SIMD<float,4> lo, SIMD<float,4> hi)
+    : m_val(_mm256_set_m128(hi.val(), lo.val())) { }
+  inline SIMD<float,4> SIMD<float,8>::lo() const { return _mm256_castps256_ps128(m_val); }
+  inline SIMD<float,4> SIMD<float,8>::hi() const { return _mm256_extractf128_ps(m_val, 1); }
+
+  inline SIMD<float,8> operator+ (SIMD<float,8> a, SIMD<float,8> b) { return _mm256_add_ps(a.val(), b.val()); }
+  inline SIMD<float,8> operator- (SIMD<float,8> a, SIMD<float,8> b) { return _mm256_sub_ps(a.val(), b.val()); }
+  inline SIMD<float,8> operator* (SIMD<float,8> a, SIMD<float,8> b) { return _mm256_mul_ps(a.val(), b.val()); }
+  inline SIMD<float,8> operator/ (SIMD<float,8> a, SIMD<float,8> b) { return _mm256_div_ps(a.val(), b.val()); }
+  inline SIMD<float,8> operator- (SIMD<float,8> a) { return _mm256_xor_ps(a.val(), _mm256_set1_ps(-0.0f)); }
+  inline SIMD<float,8> FMA (SIMD<float,8> a, SIMD<float,8> b, SIMD<float,8> c) { return _mm256_fmadd_ps(a.val(), b.val(), c.val()); }
+
+  inline SIMD<float,4> operator+ (SIMD<float,4> a, SIMD<float,4> b) { return _mm_add_ps(a.val(), b.val()); }
+  inline SIMD<float,4> operator- (SIMD<float,4> a, SIMD<float,4> b) { return _mm_sub_ps(a.val(), b.val()); }
+  inline SIMD<float,4> operator* (SIMD<float,4> a, SIMD<float,4> b) { return _mm_mul_ps(a.val(), b.val()); }
+  inline SIMD<float,4> operator/ (SIMD<float,4> a, SIMD<float,4> b) { return _mm_div_ps(a.val(), b.val()); }
+  inline SIMD<float,4> operator- (SIMD<float,4> a) { return _mm_xor_ps(a.val(), _mm_set1_ps(-0.0f)); }
+  inline SIMD<float,4> FMA (SIMD<float,4> a, SIMD<float,4> b, SIMD<float,4> c) { return _mm_fmadd_ps(a.val(), b.val(), c.val()); }
+
+  inline float HSum (SIMD<float,4> a)
+  {
+    __m128 s = _mm_add_ps(a.val(), _mm_movehl_ps(a.val(), a.val()));
+    return _mm_cvtss_f32(_mm_add_ss(s, _mm_movehdup_ps(s)));
+  }
+  inline float HSum (SIMD<float,8> a) { return HSum(a.lo() + a.hi()); }
+
+  inline SIMD<float,8> Select (SIMD<mask32,8> mask, SIMD<float,8> a, SIMD<float,8> b)
+  { return _mm256_blendv_ps(b.val(), a.val(), _mm256_castsi256_ps(mask.val())); }
+  inline SIMD<float,4> Select (SIMD<mask32,4> mask, SIMD<float,4> a, SIMD<float,4> b)
+  { return _mm_blendv_ps(b.val(), a.val(), _mm_castsi128_ps(mask.val())); }
+
+  ASC_SIMD_AVX_COMPARE(<, _CMP_LT_OQ)
+  ASC_SIMD_AVX_COMPARE(<=, _CMP_LE_OQ)
+  ASC_SIMD_AVX_COMPARE(>, _CMP_GT_OQ)
+  ASC_SIMD_AVX_COMPARE(>=, _CMP_GE_OQ)
+  ASC_SIMD_AVX_COMPARE(==, _CMP_EQ_OQ)
+  ASC_SIMD_AVX_COMPARE(!=, _CMP_NEQ_UQ)
+#undef ASC_SIMD_AVX_COMPARE
+
+
+  // ***************** int64_t *****************
+
+  template <>
+  class SIMD<int64_t,4>
+  {
+    __m256i m_val;
+  public:
+    SIMD() = default;
+    SIMD (__m256i val) : m_val(val) { }
+    SIMD (int64_t val) : m_val(_mm256_set1_epi64x(val)) { }
+    SIMD (SIMD<int64_t,2> lo, SIMD<int64_t,2> hi)
+      : SIMD(lo[0], lo[1], hi[0], hi[1]) { }
+    SIMD (int64_t v0, int64_t v1, int64_t v2, int64_t v3)
+      : m_val(_mm256_set_epi64x(v3, v2, v1, v0)) { }
+    explicit SIMD (const int64_t * ptr) : m_val(_mm256_loadu_si256((const __m256i*)ptr)) { }
+    SIMD (const int64_t * ptr, SIMD<mask64,4> mask)
+      : m_val(_mm256_maskload_epi64((const long long*)ptr, mask.val())) { }
+
+    static SIMD load_aligned (const int64_t * ptr) { return _mm256_load_si256((const __m256i*)ptr); }
+
+    static constexpr size_t size() { return 4; }
+    __m256i val() const { return m_val; }
+    SIMD<int64_t,2> lo() const { return SIMD<int64_t,2>((*this)[0], (*this)[1]); }
+    SIMD<int64_t,2> hi() const { return SIMD<int64_t,2>((*this)[2], (*this)[3]); }
+    int64_t operator[] (size_t i) const
+    {
+      alignas(32) int64_t tmp[4];
+      _mm256_store_si256((__m256i*)tmp, m_val);
+      return tmp[i];
+    }
+
+    void store (int64_t * ptr) const { _mm256_storeu_si256((__m256i*)ptr, m_val); }
+    void store_aligned (int64_t * ptr) const { _mm256_store_si256((__m256i*)ptr, m_val); }
+    void store (int64_t * ptr, SIMD<mask64,4> mask) const
+    { _mm256_maskstore_epi64((long long*)ptr, mask.val(), m_val); }
+  };
+
+  inline SIMD<int64_t,4> operator+ (SIMD<int64_t,4> a, SIMD<int64_t,4> b) { return _mm256_add_epi64(a.val(), b.val()); }
+  inline SIMD<int64_t,4> operator- (SIMD<int64_t,4> a, SIMD<int64_t,4> b) { return _mm256_sub_epi64(a.val(), b.val()); }
+  inline SIMD<int64_t,4> operator- (SIMD<int64_t,4> a) { return _mm256_sub_epi64(_mm256_setzero_si256(), a.val()); }
+  // no 64-bit integer multiply in AVX2
+  inline SIMD<int64_t,4> operator* (SIMD<int64_t,4> a, SIMD<int64_t,4> b)
+  { return SIMD<int64_t,4>(a[0]*b[0], a[1]*b[1], a[2]*b[2], a[3]*b[3]); }
+  inline SIMD<int64_t,4> FMA (SIMD<int64_t,4> a, SIMD<int64_t,4> b, SIMD<int64_t,4> c) { return a*b+c; }
+  inline int64_t HSum (SIMD<int64_t,4> a) { return a[0]+a[1]+a[2]+a[3]; }
+
+  inline SIMD<mask64,4> operator> (SIMD<int64_t,4> a, SIMD<int64_t,4> b) { return _mm256_cmpgt_epi64(a.val(), b.val()); }
+  inline SIMD<mask64,4> operator< (SIMD<int64_t,4> a, SIMD<int64_t,4> b) { return _mm256_cmpgt_epi64(b.val(), a.val()); }
+  inline SIMD<mask64,4> operator<= (SIMD<int64_t,4> a, SIMD<int64_t,4> b) { return !(a > b); }
+  inline SIMD<mask64,4> operator>= (SIMD<int64_t,4> a, SIMD<int64_t,4> b) { return !(a < b); }
+  inline SIMD<mask64,4> operator== (SIMD<int64_t,4> a, SIMD<int64_t,4> b) { return _mm256_cmpeq_epi64(a.val(), b.val()); }
+  inline SIMD<mask64,4> operator!= (SIMD<int64_t,4> a, SIMD<int64_t,4> b) { return !(a == b); }
+
+  inline SIMD<int64_t,4> Select (SIMD<mask64,4> mask, SIMD<int64_t,4> a, SIMD<int64_t,4> b)
+  { return _mm256_blendv_epi8(b.val(), a.val(), mask.val()); }
+}
+
+#endif
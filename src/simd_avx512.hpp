@@ -0,0 +1,220 @@
+#ifndef FILE_SIMD_AVX512
+#define FILE_SIMD_AVX512
+
+// AVX-512 specializations, included from simd_functions.hpp after simd_avx.hpp
+
+#include <immintrin.h>
+
+namespace ASC_bla
+{
+
+  // ***************** masks *****************
+
+  template <>
+  class SIMD<mask64,8>
+  {
+    __mmask8 m_mask;
+  public:
+    SIMD() = default;
+    SIMD (__mmask8 mask) : m_mask(mask) { }
+    SIMD (mask64 m) : m_mask(bool(m) ? 0xFF : 0) { }
+    SIMD (SIMD<mask64,4> lo, SIMD<mask64,4> hi)
+      : m_mask(_mm256_movemask_pd(_mm256_castsi256_pd(lo.val())) | (_mm256_movemask_pd(_mm256_castsi256_pd(hi.val())) << 4)) { }
+
+    static SIMD mask_first (size_t n) { return __mmask8(n >= 8 ? 0xFF : (1u << n) - 1); }
+
+    static constexpr size_t size() { return 8; }
+    __mmask8 val() const { return m_mask; }
+    SIMD<mask64,4> lo() const { return expand(m_mask); }
+    SIMD<mask64,4> hi() const { return expand(m_mask >> 4); }
+    mask64 operator[] (size_t i) const { return ((m_mask >> i) & 1) != 0; }
+  private:
+    static __m256i expand (unsigned bits)
+    {
+      __m256i sel = _mm256_and_si256(_mm256_set1_epi64x(bits), _mm256_set_epi64x(8, 4, 2, 1));
+      return _mm256_cmpgt_epi64(sel, _mm256_setzero_si256());
+    }
+  };
+
+  template <>
+  class SIMD<mask32,16>
+  {
+    __mmask16 m_mask;
+  public:
+    SIMD() = default;
+    SIMD (__mmask16 mask) : m_mask(mask) { }
+    SIMD (mask32 m) : m_mask(bool(m) ? 0xFFFF : 0) { }
+    SIMD (SIMD<mask32,8> lo, SIMD<mask32,8> hi)
+      : m_mask(_mm256_movemask_ps(_mm256_castsi256_ps(lo.val())) | (_mm256_movemask_ps(_mm256_castsi256_ps(hi.val())) << 8)) { }
+
+    static SIMD mask_first (size_t n) { return __mmask16(n >= 16 ? 0xFFFF : (1u << n) - 1); }
+
+    static constexpr size_t size() { return 16; }
+    __mmask16 val() const { return m_mask; }
+    mask32 operator[] (size_t i) const { return ((m_mask >> i) & 1) != 0; }
+  };
+
+  inline SIMD<mask64,8> operator&& (SIMD<mask64,8> a, SIMD<mask64,8> b) { return __mmask8(a.val() & b.val()); }
+  inline SIMD<mask64,8> operator|| (SIMD<mask64,8> a, SIMD<mask64,8> b) { return __mmask8(a.val() | b.val()); }
+  inline SIMD<mask64,8> operator! (SIMD<mask64,8> a) { return __mmask8(~a.val()); }
+  inline SIMD<mask32,16> operator&& (SIMD<mask32,16> a, SIMD<mask32,16> b) { return __mmask16(a.val() & b.val()); }
+  inline SIMD<mask32,16> operator|| (SIMD<mask32,16> a, SIMD<mask32,16> b) { return __mmask16(a.val() | b.val()); }
+  inline SIMD<mask32,16> operator! (SIMD<mask32,16> a) { return __mmask16(~a.val()); }
+
+
+  // ***************** double *****************
+
+  template <>
+  class SIMD<double,8>
+  {
+    __m512d m_val;
+  public:
+    SIMD() = default;
+    SIMD (__m512d val) : m_val(val) { }
+    SIMD (double val) : m_val(_mm512_set1_pd(val)) { }
+    SIMD (SIMD<double,4> lo, SIMD<double,4> hi)
+      : m_val(_mm512_insertf64x4(_mm512_castpd256_pd512(lo.val()), hi.val(), 1)) { }
+    explicit SIMD (const double * ptr) : m_val(_mm512_loadu_pd(ptr)) { }
+    SIMD (const double * ptr, SIMD<mask64,8> mask) : m_val(_mm512_maskz_loadu_pd(mask.val(), ptr)) { }
+
+    static SIMD load_aligned (const double * ptr) { return _mm512_load_pd(ptr); }
+
+    static constexpr size_t size() { return 8; }
+    __m512d val() const { return m_val; }
+    SIMD<double,4> lo() const { return _mm512_castpd512_pd256(m_val); }
+    SIMD<double,4> hi() const { return _mm512_extractf64x4_pd(m_val, 1); }
+    double operator[] (size_t i) const
+    {
+      alignas(64) double tmp[8];
+      _mm512_store_pd(tmp, m_val);
+      return tmp[i];
+    }
+
+    void store (double * ptr) const { _mm512_storeu_pd(ptr, m_val); }
+    void store_aligned (double * ptr) const { _mm512_store_pd(ptr, m_val); }
+    void store (double * ptr, SIMD<mask64,8> mask) const { _mm512_mask_storeu_pd(ptr, mask.val(), m_val); }
+  };
+
+  inline SIMD<double,8> operator+ (SIMD<double,8> a, SIMD<double,8> b) { return _mm512_add_pd(a.val(), b.val()); }
+  inline SIMD<double,8> operator- (SIMD<double,8> a, SIMD<double,8> b) { return _mm512_sub_pd(a.val(), b.val()); }
+  inline SIMD<double,8> operator* (SIMD<double,8> a, SIMD<double,8> b) { return _mm512_mul_pd(a.val(), b.val()); }
+  inline SIMD<double,8> operator/ (SIMD<double,8> a, SIMD<double,8> b) { return _mm512_div_pd(a.val(), b.val()); }
+  inline SIMD<double,8> operator- (SIMD<double,8> a) { return _mm512_sub_pd(_mm512_setzero_pd(), a.val()); }
+  inline SIMD<double,8> FMA (SIMD<double,8> a, SIMD<double,8> b, SIMD<double,8> c) { return _mm512_fmadd_pd(a.val(), b.val(), c.val()); }
+  inline double HSum (SIMD<double,8> a) { return _mm512_reduce_add_pd(a.val()); }
+
+  inline SIMD<double,8> Select (SIMD<mask64,8> mask, SIMD<double,8> a, SIMD<double,8> b)
+  { return _mm512_mask_blend_pd(mask.val(), b.val(), a.val()); }
+
+
+  // ***************** float *****************
+
+  template <>
+  class SIMD<float,16>
+  {
+    __m512 m_val;
+  public:
+    SIMD() = default;
+    SIMD (__m512 val) : m_val(val) { }
+    SIMD (float val) : m_val(_mm512_set1_ps(val)) { }
+    explicit SIMD (const float * ptr) : m_val(_mm512_loadu_ps(ptr)) { }
+    SIMD (const float * ptr, SIMD<mask32,16> mask) : m_val(_mm512_maskz_loadu_ps(mask.val(), ptr)) { }
+
+    static SIMD load_aligned (const float * ptr) { return _mm512_load_ps(ptr); }
+
+    static constexpr size_t size() { return 16; }
+    __m512 val() const { return m_val; }
+    float operator[] (size_t i) const
+    {
+      alignas(64) float tmp[16];
+      _mm512_store_ps(tmp, m_val);
+      return tmp[i];
+    }
+
+    void store (float * ptr) const { _mm512_storeu_ps(ptr, m_val); }
+    void store_aligned (float * ptr) const { _mm512_store_ps(ptr, m_val); }
+    void store (float * ptr, SIMD<mask32,16> mask) const { _mm512_mask_storeu_ps(ptr, mask.val(), m_val); }
+  };
+
+  inline SIMD<float,16> operator+ (SIMD<float,16> a, SIMD<float,16> b) { return _mm512_add_ps(a.val(), b.val()); }
+  inline SIMD<float,16> operator- (SIMD<float,16> a, SIMD<float,16> b) { return _mm512_sub_ps(a.val(), b.val()); }
+  inline SIMD<float,16> operator* (SIMD<float,16> a, SIMD<float,16> b) { return _mm512_mul_ps(a.val(), b.val()); }
+  inline SIMD<float,16> operator/ (SIMD<float,16> a, SIMD<float,16> b) { return _mm512_div_ps(a.val(), b.val()); }
+  inline SIMD<float,16> operator- (SIMD<float,16> a) { return _mm512_sub_ps(_mm512_setzero_ps(), a.val()); }
+  inline SIMD<float,16> FMA (SIMD<float,16> a, SIMD<float,16> b, SIMD<float,16> c) { return _mm512_fmadd_ps(a.val(), b.val(), c.val()); }
+  inline float HSum (SIMD<float,16> a) { return _mm512_reduce_add_ps(a.val()); }
+
+  inline SIMD<float,16> Select (SIMD<mask32,16> mask, SIMD<float,16> a, SIMD<float,16> b)
+  { return _mm512_mask_blend_ps(mask.val(), b.val(), a.val()); }
+
+#define ASC_SIMD_AVX512_COMPARE(OP, PRED)                               \
+  inline SIMD<mask64,8> operator OP (SIMD<double,8> a, SIMD<double,8> b) \
+  { return _mm512_cmp_pd_mask(a.val(), b.val(), PRED); }                 \
+  inline SIMD<mask32,16> operator OP (SIMD<float,16> a, SIMD<float,16> b) \
+  { return _mm512_cmp_ps_mask(a.val(), b.val(), PRED); }
+
+  ASC_SIMD_AVX512_COMPARE(<, _CMP_LT_OQ)
+  ASC_SIMD_AVX512_COMPARE(<=, _CMP_LE_OQ)
+  ASC_SIMD_AVX512_COMPARE(>, _CMP_GT_OQ)
+  ASC_SIMD_AVX512_COMPARE(>=, _CMP_GE_OQ)
+  ASC_SIMD_AVX512_COMPARE(==, _CMP_EQ_OQ)
+  ASC_SIMD_AVX512_COMPARE(!=, _CMP_NEQ_UQ)
+#undef ASC_SIMD_AVX512_COMPARE
+
+
+  // ***************** int64_t *****************
+
+  template <>
+  class SIMD<int64_t,8>
+  {
+    __m512i m_val;
+  public:
+    SIMD() = default;
+    SIMD (__m512i val) : m_val(val) { }
+    SIMD (int64_t val) : m_val(_mm512_set1_epi64(val)) { }
+    SIMD (SIMD<int64_t,4> lo, SIMD<int64_t,4> hi)
+      : m_val(_mm512_inserti64x4(_mm512_castsi256_si512(lo.val()), hi.val(), 1)) { }
+    explicit SIMD (const int64_t * ptr) : m_val(_mm512_loadu_si512(ptr)) { }
+    SIMD (const int64_t * ptr, SIMD<mask64,8> mask) : m_val(_mm512_maskz_loadu_epi64(mask.val(), ptr)) { }
+
+    static SIMD load_aligned (const int64_t * ptr) { return _mm512_load_si512(ptr); }
+
+    static constexpr size_t size() { return 8; }
+    __m512i val() const { return m_val; }
+    SIMD<int64_t,4> lo() const { return _mm512_castsi512_si256(m_val); }
+    SIMD<int64_t,4> hi() const { return _mm512_extracti64x4_epi64(m_val, 1); }
+    int64_t operator[] (size_t i) const
+    {
+      alignas(64) int64_t tmp[8];
+      _mm512_store_si512(tmp, m_val);
+      return tmp[i];
+    }
+
+    void store (int64_t * ptr) const { _mm512_storeu_si512(ptr, m_val); }
+    void store_aligned (int64_t * ptr) const { _mm512_store_si512(ptr, m_val); }
+    void store (int64_t * ptr, SIMD<mask64,8> mask) const { _mm512_mask_storeu_epi64(ptr, mask.val(), m_val); }
+  };
+
+  inline SIMD<int64_t,8> operator+ (SIMD<int64_t,8> a, SIMD<int64_t,8> b) { return _mm512_add_epi64(a.val(), b.val()); }
+  inline SIMD<int64_t,8> operator- (SIMD<int64_t,8> a, SIMD<int64_t,8> b) { return _mm512_sub_epi64(a.val(), b.val()); }
+  inline SIMD<int64_t,8> operator- (SIMD<int64_t,8> a) { return _mm512_sub_epi64(_mm512_setzero_si512(), a.val()); }
+#ifdef __AVX512DQ__
+  inline SIMD<int64_t,8> operator* (SIMD<int64_t,8> a, SIMD<int64_t,8> b) { return _mm512_mullo_epi64(a.val(), b.val()); }
+#else
+  inline SIMD<int64_t,8> operator* (SIMD<int64_t,8> a, SIMD<int64_t,8> b) { return SIMD<int64_t,8>(a.lo()*b.lo(), a.hi()*b.hi()); }
+#endif
+  inline SIMD<int64_t,8> FMA (SIMD<int64_t,8> a, SIMD<int64_t,8> b, SIMD<int64_t,8> c) { return a*b+c; }
+  inline int64_t HSum (SIMD<int64_t,8> a) { return _mm512_reduce_add_epi64(a.val()); }
+
+  inline SIMD<int64_t,8> Select (SIMD<mask64,8> mask, SIMD<int64_t,8> a, SIMD<int64_t,8> b)
+  { return _mm512_mask_blend_epi64(mask.val(), b.val(), a.val()); }
+
+  inline SIMD<mask64,8> operator< (SIMD<int64_t,8> a, SIMD<int64_t,8> b) { return _mm512_cmp_epi64_mask(a.val(), b.val(), _MM_CMPINT_LT); }
+  inline SIMD<mask64,8> operator<= (SIMD<int64_t,8> a, SIMD<int64_t,8> b) { return _mm512_cmp_epi64_mask(a.val(), b.val(), _MM_CMPINT_LE); }
+  inline SIMD<mask64,8> operator> (SIMD<int64_t,8> a, SIMD<int64_t,8> b) { return _mm512_cmp_epi64_mask(a.val(), b.val(), _MM_CMPINT_NLE); }
+  inline SIMD<mask64,8> operator>= (SIMD<int64_t,8> a, SIMD<int64_t,8> b) { return _mm512_cmp_epi64_mask(a.val(), b.val(), _MM_CMPINT_NLT); }
+  inline SIMD<mask64,8> operator== (SIMD<int64_t,8> a, SIMD<int64_t,8> b) { return _mm512_cmp_epi64_mask(a.val(), b.val(), _MM_CMPINT_EQ); }
+  inline SIMD<mask64,8> operator!= (SIMD<int64_t,8> a, SIMD<int64_t,8> b) { return _mm512_cmp_epi64_mask(a.val(), b.val(), _MM_CMPINT_NE); }
+}
+
+#endif
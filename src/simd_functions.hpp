@@ -2,9 +2,316 @@
 #define FILE_SIMD_FUNCTIONS
 
 #include <iostream>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+
+/*
+  Portable SIMD<T,S> vector type.
+
+  SIMD<T,S> holds S values of type T. Widths matching a hardware register
+  are specialized in simd_avx.hpp, simd_avx512.hpp and simd_arm64.hpp,
+  every other width is split recursively into a lo and a hi part, down to
+  the scalar SIMD<T,1>. The instruction set is picked at compile time from
+  the compiler flags (e.g. -march=native); define ASC_SIMD_SCALAR to force
+  the scalar fallback.
+
+  Comparisons return SIMD<mask64,S> for 64-bit types and SIMD<mask32,S>
+  for float, which are used for masked load/store and Select.
+*/
+
+#if !defined(ASC_SIMD_SCALAR)
+#if defined(__AVX2__) && defined(__FMA__)
+#define ASC_SIMD_AVX
+#endif
+#if defined(ASC_SIMD_AVX) && defined(__AVX512F__)
+#define ASC_SIMD_AVX512
+#endif
+#if defined(__aarch64__) && defined(__ARM_NEON)
+#define ASC_SIMD_NEON
+#endif
+#endif
+
+
+namespace ASC_bla
+{
+
+  class mask64
+  {
+    int64_t m_mask;
+  public:
+    mask64() = default;
+    mask64(bool b) : m_mask(b ? -1 : 0) { }
+    explicit operator bool() const { return m_mask != 0; }
+    int64_t value() const { return m_mask; }
+  };
+
+  class mask32
+  {
+    int32_t m_mask;
+  public:
+    mask32() = default;
+    mask32(bool b) : m_mask(b ? -1 : 0) { }
+    explicit operator bool() const { return m_mask != 0; }
+    int32_t value() const { return m_mask; }
+  };
+
+  // mask type returned by comparisons of SIMD<T,S>
+  template <typename T> struct SIMD_mask_type { typedef mask64 type; };
+  template <> struct SIMD_mask_type<float> { typedef mask32 type; };
+  template <> struct SIMD_mask_type<mask32> { typedef mask32 type; };
+
+  template <typename T>
+  using simd_mask_t = typename SIMD_mask_type<T>::type;
+
+
+  // number of T in one native register
+#if defined(ASC_SIMD_AVX512)
+  template <typename T> constexpr size_t SIMD_WIDTH = 64 / sizeof(T);
+#elif defined(ASC_SIMD_AVX)
+  template <typename T> constexpr size_t SIMD_WIDTH = 32 / sizeof(T);
+#elif defined(ASC_SIMD_NEON)
+  template <typename T> constexpr size_t SIMD_WIDTH = 16 / sizeof(T);
+#else
+  template <typename T> constexpr size_t SIMD_WIDTH = 1;
+#endif
+
+
+  constexpr size_t largestPowerOfTwo (size_t x)
+  {
+    size_t p = 1;
+    while (2*p <= x) p *= 2;
+    return p;
+  }
+
+
+  template <typename T, size_t S>
+  class SIMD
+  {
+    static constexpr size_t S1 = largestPowerOfTwo(S-1);
+    static constexpr size_t S2 = S-S1;
+    typedef simd_mask_t<T> TM;
+
+    SIMD<T,S1> m_lo;
+    SIMD<T,S2> m_hi;
+  public:
+    SIMD() = default;
+    SIMD (T val) : m_lo(val), m_hi(val) { }
+    SIMD (SIMD<T,S1> lo, SIMD<T,S2> hi) : m_lo(lo), m_hi(hi) { }
+
+    // unaligned load
+    explicit SIMD (const T * ptr) : m_lo(ptr), m_hi(ptr+S1) { }
+    // masked load, lanes with mask off are zero and not touched in memory
+    SIMD (const T * ptr, SIMD<TM,S> mask) : m_lo(ptr, mask.lo()), m_hi(ptr+S1, mask.hi()) { }
+
+    static SIMD load_aligned (const T * ptr)
+    {
+      return SIMD (SIMD<T,S1>::load_aligned(ptr), SIMD<T,S2>::load_aligned(ptr+S1));
+    }
+
+    // mask with the first n lanes on (only for mask types)
+    static SIMD mask_first (size_t n)
+    {
+      return SIMD (SIMD<T,S1>::mask_first(n), SIMD<T,S2>::mask_first(n > S1 ? n-S1 : 0));
+    }
+
+    static constexpr size_t size() { return S; }
+    SIMD<T,S1> lo() const { return m_lo; }
+    SIMD<T,S2> hi() const { return m_hi; }
+    T operator[] (size_t i) const { return (i < S1) ? m_lo[i] : m_hi[i-S1]; }
+
+    void store (T * ptr) const { m_lo.store(ptr); m_hi.store(ptr+S1); }
+    void store_aligned (T * ptr) const { m_lo.store_aligned(ptr); m_hi.store_aligned(ptr+S1); }
+    void store (T * ptr, SIMD<TM,S> mask) const
+    {
+      m_lo.store(ptr, mask.lo());
+      m_hi.store(ptr+S1, mask.hi());
+    }
+  };
+
+
+  template <typename T>
+  class SIMD<T,1>
+  {
+    typedef simd_mask_t<T> TM;
+    T m_val;
+  public:
+    SIMD() = default;
+    SIMD (T val) : m_val(val) { }
+    explicit SIMD (const T * ptr) : m_val(*ptr) { }
+    SIMD (const T * ptr, SIMD<TM,1> mask) : m_val(mask.val() ? *ptr : T(0)) { }
+
+    static SIMD load_aligned (const T * ptr) { return SIMD(ptr); }
+    static SIMD mask_first (size_t n) { return SIMD(T(n > 0)); }
+
+    static constexpr size_t size() { return 1; }
+    T val() const { return m_val; }
+    T operator[] (size_t i) const { return m_val; }
+
+    void store (T * ptr) const { *ptr = m_val; }
+    void store_aligned (T * ptr) const { *ptr = m_val; }
+    void store (T * ptr, SIMD<TM,1> mask) const { if (mask.val()) *ptr = m_val; }
+  };
+}
+
+
+#if defined(ASC_SIMD_AVX)
+#include "simd_avx.hpp"
+#endif
+#if defined(ASC_SIMD_AVX512)
+#include "simd_avx512.hpp"
+#endif
+#if defined(ASC_SIMD_NEON)
+#include "simd_arm64.hpp"
+#endif
+
 
 namespace ASC_bla
 {
 
+  // ***************** arithmetic, split into lo and hi *****************
+
+  template <typename T, size_t S>
+  inline SIMD<T,S> operator+ (SIMD<T,S> a, SIMD<T,S> b) { return SIMD<T,S>(a.lo()+b.lo(), a.hi()+b.hi()); }
+  template <typename T, size_t S>
+  inline SIMD<T,S> operator- (SIMD<T,S> a, SIMD<T,S> b) { return SIMD<T,S>(a.lo()-b.lo(), a.hi()-b.hi()); }
+  template <typename T, size_t S>
+  inline SIMD<T,S> operator* (SIMD<T,S> a, SIMD<T,S> b) { return SIMD<T,S>(a.lo()*b.lo(), a.hi()*b.hi()); }
+  template <typename T, size_t S>
+  inline SIMD<T,S> operator/ (SIMD<T,S> a, SIMD<T,S> b) { return SIMD<T,S>(a.lo()/b.lo(), a.hi()/b.hi()); }
+  template <typename T, size_t S>
+  inline SIMD<T,S> operator- (SIMD<T,S> a) { return SIMD<T,S>(-a.lo(), -a.hi()); }
+
+  // c + a*b
+  template <typename T, size_t S>
+  inline SIMD<T,S> FMA (SIMD<T,S> a, SIMD<T,S> b, SIMD<T,S> c)
+  { return SIMD<T,S>(FMA(a.lo(), b.lo(), c.lo()), FMA(a.hi(), b.hi(), c.hi())); }
+
+  template <typename T, size_t S>
+  inline T HSum (SIMD<T,S> a) { return HSum(a.lo()) + HSum(a.hi()); }
+
+  template <typename T>
+  inline SIMD<T,1> operator+ (SIMD<T,1> a, SIMD<T,1> b) { return a.val()+b.val(); }
+  template <typename T>
+  inline SIMD<T,1> operator- (SIMD<T,1> a, SIMD<T,1> b) { return a.val()-b.val(); }
+  template <typename T>
+  inline SIMD<T,1> operator* (SIMD<T,1> a, SIMD<T,1> b) { return a.val()*b.val(); }
+  template <typename T>
+  inline SIMD<T,1> operator/ (SIMD<T,1> a, SIMD<T,1> b) { return a.val()/b.val(); }
+  template <typename T>
+  inline SIMD<T,1> operator- (SIMD<T,1> a) { return -a.val(); }
+  template <typename T>
+  inline SIMD<T,1> FMA (SIMD<T,1> a, SIMD<T,1> b, SIMD<T,1> c) { return a.val()*b.val()+c.val(); }
+  template <typename T>
+  inline T HSum (SIMD<T,1> a) { return a.val(); }
+
+  // with scalars
+  template <typename T, size_t S>
+  inline SIMD<T,S> operator+ (T a, SIMD<T,S> b) { return SIMD<T,S>(a)+b; }
+  template <typename T, size_t S>
+  inline SIMD<T,S> operator+ (SIMD<T,S> a, T b) { return a+SIMD<T,S>(b); }
+  template <typename T, size_t S>
+  inline SIMD<T,S> operator- (SIMD<T,S> a, T b) { return a-SIMD<T,S>(b); }
+  template <typename T, size_t S>
+  inline SIMD<T,S> operator* (T a, SIMD<T,S> b) { return SIMD<T,S>(a)*b; }
+  template <typename T, size_t S>
+  inline SIMD<T,S> operator* (SIMD<T,S> a, T b) { return a*SIMD<T,S>(b); }
+  template <typename T, size_t S>
+  inline SIMD<T,S> FMA (T a, SIMD<T,S> b, SIMD<T,S> c) { return FMA(SIMD<T,S>(a), b, c); }
+
+  template <typename T, size_t S>
+  inline SIMD<T,S> & operator+= (SIMD<T,S> & a, SIMD<T,S> b) { a = a+b; return a; }
+  template <typename T, size_t S>
+  inline SIMD<T,S> & operator-= (SIMD<T,S> & a, SIMD<T,S> b) { a = a-b; return a; }
+  template <typename T, size_t S>
+  inline SIMD<T,S> & operator*= (SIMD<T,S> & a, SIMD<T,S> b) { a = a*b; return a; }
+
+
+  // ***************** comparison and select *****************
+
+#define ASC_SIMD_COMPARE(OP)                                            \
+  template <typename T, size_t S>                                       \
+  inline SIMD<simd_mask_t<T>,S> operator OP (SIMD<T,S> a, SIMD<T,S> b)  \
+  { return SIMD<simd_mask_t<T>,S>(a.lo() OP b.lo(), a.hi() OP b.hi()); } \
+  template <typename T>                                                 \
+  inline SIMD<simd_mask_t<T>,1> operator OP (SIMD<T,1> a, SIMD<T,1> b)  \
+  { return simd_mask_t<T>(a.val() OP b.val()); }
+
+  ASC_SIMD_COMPARE(<)
+  ASC_SIMD_COMPARE(<=)
+  ASC_SIMD_COMPARE(>)
+  ASC_SIMD_COMPARE(>=)
+  ASC_SIMD_COMPARE(==)
+  ASC_SIMD_COMPARE(!=)
+#undef ASC_SIMD_COMPARE
+
+  template <typename TM, size_t S>
+  inline SIMD<TM,S> operator&& (SIMD<TM,S> a, SIMD<TM,S> b) { return SIMD<TM,S>(a.lo() && b.lo(), a.hi() && b.hi()); }
+  template <typename TM, size_t S>
+  inline SIMD<TM,S> operator|| (SIMD<TM,S> a, SIMD<TM,S> b) { return SIMD<TM,S>(a.lo() || b.lo(), a.hi() || b.hi()); }
+  template <typename TM, size_t S>
+  inline SIMD<TM,S> operator! (SIMD<TM,S> a) { return SIMD<TM,S>(!a.lo(), !a.hi()); }
+
+  template <typename TM>
+  inline SIMD<TM,1> operator&& (SIMD<TM,1> a, SIMD<TM,1> b) { return TM(bool(a.val()) && bool(b.val())); }
+  template <typename TM>
+  inline SIMD<TM,1> operator|| (SIMD<TM,1> a, SIMD<TM,1> b) { return TM(bool(a.val()) || bool(b.val())); }
+  template <typename TM>
+  inline SIMD<TM,1> operator! (SIMD<TM,1> a) { return TM(!bool(a.val())); }
+
+  // mask ? a : b, lane by lane
+  template <typename TM, typename T, size_t S>
+  inline SIMD<T,S> Select (SIMD<TM,S> mask, SIMD<T,S> a, SIMD<T,S> b)
+  { return SIMD<T,S>(Select(mask.lo(), a.lo(), b.lo()), Select(mask.hi(), a.hi(), b.hi())); }
+
+  template <typename TM, typename T>
+  inline SIMD<T,1> Select (SIMD<TM,1> mask, SIMD<T,1> a, SIMD<T,1> b)
+  { return mask.val() ? a.val() : b.val(); }
+
+
+  // ***************** compile-time loops *****************
+
+  template <typename F, size_t ...I>
+  inline void UnrollImpl (F && f, std::index_sequence<I...>)
+  {
+    (f(std::integral_constant<size_t,I>()), ...);
+  }
+
+  // calls f(0), ..., f(N-1) with compile-time indices, independent of
+  // the compiler's unroll heuristics
+  template <size_t N, typename F>
+  inline void Unroll (F && f)
+  {
+    UnrollImpl(f, std::make_index_sequence<N>());
+  }
+
+
+  // ***************** Output operator *****************
+
+  template <typename T, size_t S>
+  std::ostream & operator<< (std::ostream & ost, SIMD<T,S> s)
+  {
+    ost << s[0];
+    for (size_t i = 1; i < S; i++)
+      ost << ", " << s[i];
+    return ost;
+  }
+
+  template <size_t S>
+  std::ostream & operator<< (std::ostream & ost, SIMD<mask64,S> s)
+  {
+    for (size_t i = 0; i < S; i++)
+      ost << (bool(s[i]) ? 't' : 'f');
+    return ost;
+  }
+
+  template <size_t S>
+  std::ostream & operator<< (std::ostream & ost, SIMD<mask32,S> s)
+  {
+    for (size_t i = 0; i < S; i++)
+      ost << (bool(s[i]) ? 't' : 'f');
+    return ost;
+  }
 }
 #endif
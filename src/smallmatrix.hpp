@@ -0,0 +1,350 @@
+#ifndef FILE_SMALLMATRIX
+#define FILE_SMALLMATRIX
+
+#include <cassert>
+#include <cmath>
+#include <stdexcept>
+#include <utility>
+#include <type_traits>
+
+#include "vecexpr.hpp"
+#include "matrixexpr.hpp"
+#include "reduction.hpp"
+#include "simd_functions.hpp"
+
+/*
+  Vectors and matrices with sizes known at compile time, for the many
+  small element matrices of finite element assembly. The entries are
+  stored inside the object, so they live on the stack and are never
+  allocated. Loops over the entries are unrolled with Unroll<N>.
+  Determinant and inverse are closed formulas up to 4x4, and unrolled
+  Gauss-Jordan elimination above.
+
+  Mat is column major like Matrix, and m(x,y) is column x, row y.
+  Both are expressions, so they mix with Vector and Matrix.
+*/
+
+namespace ASC_bla
+{
+
+  template <size_t N, typename T = double>
+  class Vec : public VecExpr<Vec<N,T>>
+  {
+    T m_data[N];
+  public:
+    Vec() = default;
+    Vec (const Vec &) = default;
+
+    Vec (T scal) { *this = scal; }
+
+    // Vec<3> v(1, 2, 3)
+    template <typename ... TS,
+              typename = std::enable_if_t<(N > 1) && sizeof...(TS) == N>>
+    Vec (TS ... vals) : m_data{ T(vals)... } { }
+
+    template <typename TB>
+    Vec (const VecExpr<TB> & v) { *this = v; }
+
+    Vec & operator= (const Vec &) = default;
+
+    template <typename TB>
+    Vec & operator= (const VecExpr<TB> & v)
+    {
+      assert (v.size() == N);
+      const TB & expr = static_cast<const TB&>(v);
+      Unroll<N> ([&] (auto i) { m_data[i] = expr(i); });
+      return *this;
+    }
+
+    Vec & operator= (T scal)
+    {
+      Unroll<N> ([&] (auto i) { m_data[i] = scal; });
+      return *this;
+    }
+
+    static constexpr size_t size() { return N; }
+    T * data() { return m_data; }
+    const T * data() const { return m_data; }
+
+    T & operator()(size_t i) { return m_data[i]; }
+    const T & operator()(size_t i) const { return m_data[i]; }
+
+    static constexpr bool contiguous() { return true; }
+    template <size_t S>
+    SIMD<T,S> eval_simd (size_t i) const { return SIMD<T,S>(m_data+i); }
+  };
+
+  template <size_t N, typename T>
+  constexpr bool hold_by_reference<Vec<N,T>> = true;
+
+  template <size_t N, typename T>
+  struct simd_scalar<Vec<N,T>>
+  {
+    typedef std::conditional_t<std::is_same_v<T,double> || std::is_same_v<T,float>, T, void> type;
+  };
+
+
+  template <size_t H, size_t W, typename T = double>
+  class Mat : public MatrixExpr<Mat<H,W,T>>
+  {
+    T m_data[H*W];
+  public:
+    Mat() = default;
+    Mat (const Mat &) = default;
+
+    Mat (T scal) { *this = scal; }
+
+    template <typename TB>
+    Mat (const MatrixExpr<TB> & m) { *this = m; }
+
+    static Mat Identity()
+    {
+      static_assert (H == W, "identity of a non-square matrix");
+      Mat id(T(0));
+      Unroll<H> ([&] (auto i) { id(i,i) = T(1); });
+      return id;
+    }
+
+    Mat & operator= (const Mat &) = default;
+
+    template <typename TB>
+    Mat & operator= (const MatrixExpr<TB> & m)
+    {
+      assert (m.width() == W && m.height() == H);
+      const TB & expr = static_cast<const TB&>(m);
+      Unroll<W> ([&] (auto x)
+      {
+        Unroll<H> ([&] (auto y) { m_data[x*H+y] = expr(x,y); });
+      });
+      return *this;
+    }
+
+    Mat & operator= (T scal)
+    {
+      Unroll<H*W> ([&] (auto i) { m_data[i] = scal; });
+      return *this;
+    }
+
+    static constexpr size_t width() { return W; }
+    static constexpr size_t height() { return H; }
+    T * data() { return m_data; }
+    const T * data() const { return m_data; }
+
+    T & operator()(size_t x, size_t y) { return m_data[x*H+y]; }
+    const T & operator()(size_t x, size_t y) const { return m_data[x*H+y]; }
+  };
+
+
+  template <size_t H, size_t W, typename T>
+  constexpr bool hold_by_reference<Mat<H,W,T>> = true;
+
+
+  // these overloads are exact matches, the generic expression operators
+  // would need a conversion to the base class, so they are preferred
+
+  template <size_t H, size_t K, size_t W, typename T>
+  Mat<H,W,T> operator* (const Mat<H,K,T> & a, const Mat<K,W,T> & b)
+  {
+    Mat<H,W,T> c(T(0));
+    Unroll<W> ([&] (auto x)
+    {
+      Unroll<K> ([&] (auto l)
+      {
+        T bl = b(x,l);
+        Unroll<H> ([&] (auto y) { c(x,y) += a(l,y) * bl; });
+      });
+    });
+    return c;
+  }
+
+  template <size_t H, size_t W, typename T>
+  Vec<H,T> operator* (const Mat<H,W,T> & a, const Vec<W,T> & v)
+  {
+    Vec<H,T> c(T(0));
+    Unroll<W> ([&] (auto x)
+    {
+      Unroll<H> ([&] (auto y) { c(y) += a(x,y) * v(x); });
+    });
+    return c;
+  }
+
+  template <size_t H, size_t W, typename T>
+  Mat<W,H,T> Trans (const Mat<H,W,T> & a)
+  {
+    Mat<W,H,T> t;
+    Unroll<W> ([&] (auto x)
+    {
+      Unroll<H> ([&] (auto y) { t(y,x) = a(x,y); });
+    });
+    return t;
+  }
+
+
+  /*
+    Determinant and inverse. The formulas are written for b[i][j] = a(i,j);
+    since det(A^T) = det(A) and inv(A^T) = inv(A)^T, they hold for either
+    orientation as long as the result is stored the same way.
+  */
+
+  template <size_t N, typename T>
+  T Det (const Mat<N,N,T> & a)
+  {
+    if constexpr (N == 1)
+      return a(0,0);
+    else if constexpr (N == 2)
+      return a(0,0)*a(1,1) - a(0,1)*a(1,0);
+    else if constexpr (N == 3)
+      return a(0,0) * (a(1,1)*a(2,2) - a(1,2)*a(2,1))
+        - a(0,1) * (a(1,0)*a(2,2) - a(1,2)*a(2,0))
+        + a(0,2) * (a(1,0)*a(2,1) - a(1,1)*a(2,0));
+    else if constexpr (N == 4)
+      {
+        // products of 2x2 minors of the first two and the last two rows
+        T s0 = a(0,0)*a(1,1) - a(1,0)*a(0,1);
+        T s1 = a(0,0)*a(1,2) - a(1,0)*a(0,2);
+        T s2 = a(0,0)*a(1,3) - a(1,0)*a(0,3);
+        T s3 = a(0,1)*a(1,2) - a(1,1)*a(0,2);
+        T s4 = a(0,1)*a(1,3) - a(1,1)*a(0,3);
+        T s5 = a(0,2)*a(1,3) - a(1,2)*a(0,3);
+        T c5 = a(2,2)*a(3,3) - a(3,2)*a(2,3);
+        T c4 = a(2,1)*a(3,3) - a(3,1)*a(2,3);
+        T c3 = a(2,1)*a(3,2) - a(3,1)*a(2,2);
+        T c2 = a(2,0)*a(3,3) - a(3,0)*a(2,3);
+        T c1 = a(2,0)*a(3,2) - a(3,0)*a(2,2);
+        T c0 = a(2,0)*a(3,1) - a(3,0)*a(2,1);
+        return s0*c5 - s1*c4 + s2*c3 + s3*c2 - s4*c1 + s5*c0;
+      }
+    else
+      {
+        // elimination with partial pivoting, the determinant is the product of the pivots
+        Mat<N,N,T> b = a;
+        T det(1);
+        for (size_t k = 0; k < N; k++)
+          {
+            size_t p = k;
+            for (size_t i = k+1; i < N; i++)
+              if (std::abs(b(i,k)) > std::abs(b(p,k))) p = i;
+            if (b(p,k) == T(0)) return T(0);
+            if (p != k)
+              {
+                Unroll<N> ([&] (auto j) { std::swap (b(k,j), b(p,j)); });
+                det = -det;
+              }
+            det *= b(k,k);
+            T inv = T(1) / b(k,k);
+            for (size_t i = k+1; i < N; i++)
+              {
+                T f = b(i,k) * inv;
+                Unroll<N> ([&] (auto j) { b(i,j) -= f * b(k,j); });
+              }
+          }
+        return det;
+      }
+  }
+
+
+  // throws for singular matrices, like Matrix::Inverse
+  template <size_t N, typename T>
+  Mat<N,N,T> Inverse (const Mat<N,N,T> & a)
+  {
+    Mat<N,N,T> r;
+    if constexpr (N <= 4)
+      {
+        T det = Det(a);
+        if (det == T(0))
+          throw std::runtime_error("Matrix ist singulär und kann nicht invertiert werden.");
+        T inv = T(1) / det;
+
+        if constexpr (N == 1)
+          r(0,0) = inv;
+        else if constexpr (N == 2)
+          {
+            r(0,0) = inv * a(1,1);
+            r(0,1) = -inv * a(0,1);
+            r(1,0) = -inv * a(1,0);
+            r(1,1) = inv * a(0,0);
+          }
+        else if constexpr (N == 3)
+          {
+            // adjugate divided by the determinant
+            r(0,0) = inv * (a(1,1)*a(2,2) - a(1,2)*a(2,1));
+            r(0,1) = inv * (a(0,2)*a(2,1) - a(0,1)*a(2,2));
+            r(0,2) = inv * (a(0,1)*a(1,2) - a(0,2)*a(1,1));
+            r(1,0) = inv * (a(1,2)*a(2,0) - a(1,0)*a(2,2));
+            r(1,1) = inv * (a(0,0)*a(2,2) - a(0,2)*a(2,0));
+            r(1,2) = inv * (a(0,2)*a(1,0) - a(0,0)*a(1,2));
+            r(2,0) = inv * (a(1,0)*a(2,1) - a(1,1)*a(2,0));
+            r(2,1) = inv * (a(0,1)*a(2,0) - a(0,0)*a(2,1));
+            r(2,2) = inv * (a(0,0)*a(1,1) - a(0,1)*a(1,0));
+          }
+        else
+          {
+            T s0 = a(0,0)*a(1,1) - a(1,0)*a(0,1);
+            T s1 = a(0,0)*a(1,2) - a(1,0)*a(0,2);
+            T s2 = a(0,0)*a(1,3) - a(1,0)*a(0,3);
+            T s3 = a(0,1)*a(1,2) - a(1,1)*a(0,2);
+            T s4 = a(0,1)*a(1,3) - a(1,1)*a(0,3);
+            T s5 = a(0,2)*a(1,3) - a(1,2)*a(0,3);
+            T c5 = a(2,2)*a(3,3) - a(3,2)*a(2,3);
+            T c4 = a(2,1)*a(3,3) - a(3,1)*a(2,3);
+            T c3 = a(2,1)*a(3,2) - a(3,1)*a(2,2);
+            T c2 = a(2,0)*a(3,3) - a(3,0)*a(2,3);
+            T c1 = a(2,0)*a(3,2) - a(3,0)*a(2,2);
+            T c0 = a(2,0)*a(3,1) - a(3,0)*a(2,1);
+
+            r(0,0) = inv * ( a(1,1)*c5 - a(1,2)*c4 + a(1,3)*c3);
+            r(0,1) = inv * (-a(0,1)*c5 + a(0,2)*c4 - a(0,3)*c3);
+            r(0,2) = inv * ( a(3,1)*s5 - a(3,2)*s4 + a(3,3)*s3);
+            r(0,3) = inv * (-a(2,1)*s5 + a(2,2)*s4 - a(2,3)*s3);
+            r(1,0) = inv * (-a(1,0)*c5 + a(1,2)*c2 - a(1,3)*c1);
+            r(1,1) = inv * ( a(0,0)*c5 - a(0,2)*c2 + a(0,3)*c1);
+            r(1,2) = inv * (-a(3,0)*s5 + a(3,2)*s2 - a(3,3)*s1);
+            r(1,3) = inv * ( a(2,0)*s5 - a(2,2)*s2 + a(2,3)*s1);
+            r(2,0) = inv * ( a(1,0)*c4 - a(1,1)*c2 + a(1,3)*c0);
+            r(2,1) = inv * (-a(0,0)*c4 + a(0,1)*c2 - a(0,3)*c0);
+            r(2,2) = inv * ( a(3,0)*s4 - a(3,1)*s2 + a(3,3)*s0);
+            r(2,3) = inv * (-a(2,0)*s4 + a(2,1)*s2 - a(2,3)*s0);
+            r(3,0) = inv * (-a(1,0)*c3 + a(1,1)*c1 - a(1,2)*c0);
+            r(3,1) = inv * ( a(0,0)*c3 - a(0,1)*c1 + a(0,2)*c0);
+            r(3,2) = inv * (-a(3,0)*s3 + a(3,1)*s1 - a(3,2)*s0);
+            r(3,3) = inv * ( a(2,0)*s3 - a(2,1)*s1 + a(2,2)*s0);
+          }
+      }
+    else
+      {
+        // Gauss-Jordan with partial pivoting, row operations on b and r
+        Mat<N,N,T> b = a;
+        r = Mat<N,N,T>::Identity();
+        for (size_t k = 0; k < N; k++)
+          {
+            size_t p = k;
+            for (size_t i = k+1; i < N; i++)
+              if (std::abs(b(i,k)) > std::abs(b(p,k))) p = i;
+            if (b(p,k) == T(0))
+              throw std::runtime_error("Matrix ist singulär und kann nicht invertiert werden.");
+            if (p != k)
+              Unroll<N> ([&] (auto j)
+              {
+                std::swap (b(k,j), b(p,j));
+                std::swap (r(k,j), r(p,j));
+              });
+            T inv = T(1) / b(k,k);
+            Unroll<N> ([&] (auto j) { b(k,j) *= inv; r(k,j) *= inv; });
+            for (size_t i = 0; i < N; i++)
+              if (i != k)
+                {
+                  T f = b(i,k);
+                  Unroll<N> ([&] (auto j)
+                  {
+                    b(i,j) -= f * b(k,j);
+                    r(i,j) -= f * r(k,j);
+                  });
+                }
+          }
+      }
+    return r;
+  }
+
+}
+
+#endif
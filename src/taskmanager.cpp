@@ -1,7 +1,28 @@
 #include <chrono>
 #include <thread>
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include <condition_variable>
+#include <cstdlib>
+#include <algorithm>
 
-#include <concurrentqueue.h>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <fstream>
+#include <tuple>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#if defined(__amd64__)
+#include <immintrin.h>
+#elif defined(_M_AMD64)
+#include <intrin.h>
+#endif
 
 #include "taskmanager.hpp"
 #include "timer.hpp"
@@ -10,112 +31,804 @@
 namespace ASC_HPC
 {
 
-  class Task
+  /*
+    A parallel loop is a Job, pieces of it are Ranges [begin,end).
+    Every thread calling RunParallel, worker or not, owns a Chase-Lev
+    deque of Ranges: the owner pushes and pops at the bottom, other
+    threads steal from the top. A thread running a Range splits off the
+    upper half onto its deque only if the deque is empty, so a loop costs
+    O(log n) deque operations per thread, and thieves always find
+    the largest pieces (lazy binary splitting).
+  */
+  struct Job
+  {
+    FunctionRef<void(int nr, int size)> func;
+    int size;
+    std::atomic<int> remaining;   // indices not yet finished
+  };
+
+  struct Range
+  {
+    Job * job;
+    int begin, end;
+  };
+
+  class TaskDeque
+  {
+    static constexpr int64_t CAPACITY = 256;   // power of 2
+    alignas(64) std::atomic<int64_t> top{0};
+    alignas(64) std::atomic<int64_t> bottom{0};
+    // entries are atomic since a thief may read a slot the owner overwrites,
+    // the CAS on top tells whether the read was valid
+    struct Entry
+    {
+      std::atomic<Job*> job{nullptr};
+      std::atomic<int64_t> range{0};
+    };
+    Entry buffer[CAPACITY];
+
+    void write (int64_t i, Range r)
+    {
+      Entry & e = buffer[i & (CAPACITY-1)];
+      e.job.store(r.job, std::memory_order_relaxed);
+      e.range.store((int64_t(r.begin) << 32) | uint32_t(r.end), std::memory_order_relaxed);
+    }
+    Range read (int64_t i) const
+    {
+      const Entry & e = buffer[i & (CAPACITY-1)];
+      int64_t range = e.range.load(std::memory_order_relaxed);
+      return { e.job.load(std::memory_order_relaxed), int(range >> 32), int(uint32_t(range)) };
+    }
+    
+  public:
+    bool empty() const
+    {
+      return bottom.load(std::memory_order_relaxed) <= top.load(std::memory_order_relaxed);
+    }
+    
+    // owner only, false if the deque is full
+    bool push (Range r)
+    {
+      int64_t b = bottom.load(std::memory_order_relaxed);
+      int64_t t = top.load(std::memory_order_acquire);
+      if (b-t >= CAPACITY) return false;
+      write(b, r);
+      std::atomic_thread_fence(std::memory_order_release);
+      bottom.store(b+1, std::memory_order_relaxed);
+      return true;
+    }
+
+    // owner only, pushes as many as fit with one store of bottom
+    int pushBulk (const Range * r, int n)
+    {
+      int64_t b = bottom.load(std::memory_order_relaxed);
+      int64_t t = top.load(std::memory_order_acquire);
+      n = std::min<int64_t>(n, CAPACITY-(b-t));
+      for (int i = 0; i < n; i++)
+        write(b+i, r[i]);
+      std::atomic_thread_fence(std::memory_order_release);
+      bottom.store(b+n, std::memory_order_relaxed);
+      return n;
+    }
+
+    // owner only
+    bool pop (Range & r)
+    {
+      int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+      bottom.store(b, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      int64_t t = top.load(std::memory_order_relaxed);
+      if (t > b)
+        {
+          bottom.store(b+1, std::memory_order_relaxed);
+          return false;
+        }
+      r = read(b);
+      if (t == b)
+        {
+          // last entry, race against thieves
+          bool won = top.compare_exchange_strong(t, t+1, std::memory_order_seq_cst,
+                                                 std::memory_order_relaxed);
+          bottom.store(b+1, std::memory_order_relaxed);
+          return won;
+        }
+      return true;
+    }
+
+    // any thread
+    bool steal (Range & r)
+    {
+      int64_t t = top.load(std::memory_order_acquire);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      int64_t b = bottom.load(std::memory_order_acquire);
+      if (t >= b) return false;
+      r = read(t);
+      return top.compare_exchange_strong(t, t+1, std::memory_order_seq_cst,
+                                         std::memory_order_relaxed);
+    }
+  };
+
+
+  /*
+    A single Range handed to a specific thread, so that the same piece
+    of repeated loops runs on the same thread (and NUMA node).
+    state = 4*seq + { 0 .. empty, 1 .. being filled, 2 .. full },
+    the sequence number makes a stale take fail.
+    Idle threads may also take the Range of someone else's inbox.
+  */
+  class Inbox
   {
+    alignas(64) std::atomic<uint64_t> state{0};
+    std::atomic<Job*> job{nullptr};
+    std::atomic<int64_t> range{0};
   public:
-    int nr, size;
-    const std::function<void(int nr, int size)> * pfunc;
-    std::atomic<int> * cnt;
+    bool put (Range r)
+    {
+      uint64_t s = state.load(std::memory_order_relaxed);
+      if (s % 4 != 0 || !state.compare_exchange_strong(s, s+1, std::memory_order_acquire))
+        return false;
+      job.store(r.job, std::memory_order_relaxed);
+      range.store((int64_t(r.begin) << 32) | uint32_t(r.end), std::memory_order_relaxed);
+      state.store(s+2, std::memory_order_release);
+      return true;
+    }
 
-    Task & operator++(int)
+    bool take (Range & r)
     {
-      nr++;
-      return *this;
+      uint64_t s = state.load(std::memory_order_acquire);
+      if (s % 4 != 2) return false;
+      int64_t rg = range.load(std::memory_order_relaxed);
+      r = Range{ job.load(std::memory_order_relaxed), int(rg >> 32), int(uint32_t(rg)) };
+      return state.compare_exchange_strong(s, s+2, std::memory_order_acq_rel);
     }
-    Task & operator*() { return *this; }
   };
 
-  
-  typedef moodycamel::ConcurrentQueue<Task> TQueue; 
-  typedef moodycamel::ProducerToken TPToken; 
-  typedef moodycamel::ConsumerToken TCToken; 
-  
+  /*
+    Deques are never freed, a thread claims a free slot on its first
+    RunParallel and gives it back when it exits.
+  */
+  constexpr int MAX_DEQUES = 256;
+  constexpr int MAX_BULK = 255;      // pieces pushed at the start of a loop
+  static TaskDeque deques[MAX_DEQUES];
+  static Inbox inboxes[MAX_DEQUES];
+  static std::atomic<bool> deque_used[MAX_DEQUES];
+  static std::atomic<int> num_deques{0};   // slots ever used
+
+  static thread_local struct DequeSlot
+  {
+    int nr = -1;
+    uint32_t seed = 0;
+    ~DequeSlot() { if (nr >= 0) deque_used[nr] = false; }
+  } my_slot;
+
+  static TaskDeque * myDeque()
+  {
+    if (my_slot.nr < 0)
+      for (int i = 0; i < MAX_DEQUES; i++)
+        if (!deque_used[i].load(std::memory_order_relaxed) && !deque_used[i].exchange(true))
+          {
+            my_slot.nr = i;
+            my_slot.seed = 2654435761u * (i+1);
+            int n = num_deques;
+            while (n < i+1 && !num_deques.compare_exchange_weak(n, i+1)) ;
+            break;
+          }
+    return (my_slot.nr >= 0) ? &deques[my_slot.nr] : nullptr;
+  }
+
+  // try the other deques once, starting at a random one, then the inboxes
+  static bool stealAny (Range & r)
+  {
+    int n = num_deques;
+    if (n <= 1) return false;
+    uint32_t & x = my_slot.seed;
+    x ^= x << 13; x ^= x >> 17; x ^= x << 5;
+    int first = x % n;
+    for (int i = 0; i < n; i++)
+      {
+        int victim = (first+i) % n;
+        if (victim != my_slot.nr && deques[victim].steal(r))
+          return true;
+      }
+    for (int i = 0; i < n; i++)
+      {
+        int victim = (first+i) % n;
+        if (victim != my_slot.nr && inboxes[victim].take(r))
+          return true;
+      }
+    return false;
+  }
+
+  // own inbox, own deque, then stealing
+  static bool findWork (TaskDeque & dq, Range & r)
+  {
+    return inboxes[my_slot.nr].take(r) || dq.pop(r) || stealAny(r);
+  }
+
+  static void announceWork();
+
+  // run the range, splitting off the upper half whenever the own deque ran empty
+  static void execute (TaskDeque & dq, Range r)
+  {
+    Job & job = *r.job;
+    int b = r.begin, e = r.end;
+    int done = 0;
+    while (b < e)
+      {
+        if (e-b > 1 && dq.empty())
+          {
+            int mid = b + (e-b)/2;
+            if (dq.push(Range{&job, mid, e}))
+              {
+                e = mid;
+                announceWork();
+              }
+          }
+        job.func(b, job.size);
+        b++;
+        done++;
+      }
+    job.remaining -= done;
+  }
+
   
   static std::atomic<bool> stop{false};
   static std::vector<std::thread> threads;
-  static TQueue queue;
+
+  /*
+    Idle threads back off in three phases: they spin on the deques for
+    spin_time, then yield for another spin_time, then sleep on a
+    condition variable. RunParallel announces new work by incrementing
+    work_epoch, and wakes the sleepers if there are any.
+  */
+  static std::atomic<size_t> work_epoch{0};
+  static std::atomic<int> sleeping{0};
+  static std::mutex sleep_mutex;
+  static std::condition_variable sleep_cv;
+  static std::atomic<int> spin_time_us{-1};  // -1 .. not yet initialized
+
+  static std::atomic<size_t> stat_sleeps{0};
+  static std::atomic<size_t> stat_wakeups{0};
+  static std::atomic<size_t> stat_spin_ns{0};
+
+  inline void cpuRelax()
+  {
+#if defined(__amd64__) || defined(_M_AMD64)
+    _mm_pause();
+#elif defined(__aarch64__)
+    __asm__ __volatile__("yield");
+#endif
+  }
+
+  static std::chrono::microseconds SpinTime()
+  {
+    int us = spin_time_us;
+    if (us < 0)
+      {
+        us = 100;
+        if (const char * env = std::getenv("ASC_SPIN_TIME"))
+          us = std::max(0, std::atoi(env));
+        spin_time_us = us;
+      }
+    return std::chrono::microseconds(us);
+  }
+
+  static void announceWork()
+  {
+    work_epoch++;
+    if (sleeping)
+      {
+        std::lock_guard<std::mutex> lock(sleep_mutex);
+        sleep_cv.notify_all();
+      }
+  }
+
+  /*
+    Waits until work_epoch differs from epoch, or until done() returns true.
+    epoch has to be read before the last unsuccessful look for work,
+    otherwise a wakeup may get lost. A thread which may sleep does not
+    pass done(), it only wakes for new work or stop.
+  */
+  template <typename FDONE>
+  static void backOff (size_t epoch, bool may_sleep, FDONE done)
+  {
+    auto start = std::chrono::steady_clock::now();
+    auto spin_end = start + SpinTime();
+    auto yield_end = spin_end + SpinTime();
+    auto now = start;
+    
+    while (work_epoch == epoch && !stop && !done())
+      {
+        if (now < spin_end)
+          for (int i = 0; i < 32; i++)
+            cpuRelax();
+        else if (now < yield_end || !may_sleep)
+          std::this_thread::yield();
+        else
+          break;
+        now = std::chrono::steady_clock::now();
+      }
+    stat_spin_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(now-start).count();
+
+    if (!may_sleep || work_epoch != epoch || stop)
+      return;
+
+    std::unique_lock<std::mutex> lock(sleep_mutex);
+    sleeping++;
+    stat_sleeps++;
+    sleep_cv.wait(lock, [epoch] { return work_epoch != epoch || stop; });
+    sleeping--;
+    stat_wakeups++;
+  }
+
   
-  void StartWorkers(int num)
+  static std::mutex pool_mutex;
+  static std::atomic<int> pool_threads{0};  // threads of the running pool (with caller), 0 .. not running
+  static int pool_users = 0;                // TaskManager objects alive
+  static bool default_pool = false;         // the global pool is running
+  static int requested_threads = 0;         // from SetNumThreads
+
+  /*
+    Pool threads are numbered, 0 is the thread calling RunParallel from
+    outside, workers are 1 ... pool_threads-1. Piece p of a loop goes to
+    the inbox of thread (caller+p) % pool_threads.
+  */
+  static thread_local int thread_nr = 0;
+  static std::atomic<int> thread_slot[MAX_DEQUES];   // deque slot of worker i, -1 if not ready
+
+  static Pinning pinning = Pinning::None;
+  static bool pinning_initialized = false;
+  static std::atomic<int> threads_pinned{-1};   // -1: not known yet
+
+  static Pinning DefaultPinning()
+  {
+    if (!pinning_initialized)
+      {
+        pinning_initialized = true;
+        if (const char * env = std::getenv("ASC_PIN_THREADS"))
+          {
+            std::string policy(env);
+            if (policy == "compact") pinning = Pinning::Compact;
+            if (policy == "scatter") pinning = Pinning::Scatter;
+          }
+      }
+    return pinning;
+  }
+
+  std::vector<int> PinningOrder (Pinning policy, const std::vector<CpuTopology> & topology)
+  {
+    struct CpuInfo { int cpu, socket, core, smt, rank; };
+    std::vector<CpuInfo> cpus;
+    for (auto & t : topology)
+      cpus.push_back({ t.cpu, t.socket, t.core, 0, 0 });
+
+    // smt: number of the hyper-thread on its core, rank: number of the core on its socket
+    for (auto & c : cpus)
+      for (auto & c2 : cpus)
+        if (c2.socket == c.socket && c2.core == c.core && c2.cpu < c.cpu)
+          c.smt++;
+    for (auto & c : cpus)
+      for (auto & c2 : cpus)
+        if (c2.socket == c.socket && c2.smt == c.smt && c2.cpu < c.cpu)
+          c.rank++;
+
+    // the first hyper-threads of all sockets come before the second ones
+    if (policy == Pinning::Compact)
+      std::sort(cpus.begin(), cpus.end(), [] (auto & a, auto & b)
+      { return std::tie(a.smt, a.socket, a.rank) < std::tie(b.smt, b.socket, b.rank); });
+    else
+      std::sort(cpus.begin(), cpus.end(), [] (auto & a, auto & b)
+      { return std::tie(a.smt, a.rank, a.socket) < std::tie(b.smt, b.rank, b.socket); });
+
+    std::vector<int> order;
+    for (auto & c : cpus)
+      order.push_back(c.cpu);
+    return order;
+  }
+
+  // the cpus we may run on, in the order threads are placed on them
+  static std::vector<int> PinningOrder (Pinning policy)
   {
+    std::vector<CpuTopology> cpus;
+#ifdef __linux__
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+      return { };
+
+    auto readTopology = [] (int cpu, const char * what)
+    {
+      std::ifstream file("/sys/devices/system/cpu/cpu"+std::to_string(cpu)+"/topology/"+what);
+      int val = 0;
+      file >> val;
+      return val;
+    };
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+      if (CPU_ISSET(cpu, &allowed))
+        cpus.push_back({ cpu, readTopology(cpu, "physical_package_id"), readTopology(cpu, "core_id") });
+#endif
+    return PinningOrder (policy, cpus);
+  }
+
+  static void pinThread (std::thread & t, int cpu)
+  {
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    pthread_setaffinity_np(t.native_handle(), sizeof(set), &set);
+#endif
+  }
+
+  // every worker needs a deque slot
+  static int clampThreads (int num) { return std::min(num, MAX_DEQUES); }
+
+  static int DefaultNumThreads()
+  {
+    if (requested_threads > 0)
+      return clampThreads(requested_threads);
+    if (const char * env = std::getenv("ASC_NUM_THREADS"))
+      if (int num = std::atoi(env); num > 0)
+        return clampThreads(num);
+    return clampThreads(std::max(1, int(std::thread::hardware_concurrency())));
+  }
+
+  // all pool functions are called with pool_mutex locked
+  static void startPool(int num_threads)
+  {
+    num_threads = clampThreads(num_threads);
     stop = false;
-    for (int i = 0; i < num; i++)
+    std::vector<int> cpus;
+    if (DefaultPinning() != Pinning::None)
+      cpus = PinningOrder(pinning);
+
+    for (int i = 1; i < num_threads; i++)
       {
+        thread_slot[i] = -1;
         TimeLine * patl = timeline.get();
         threads.push_back
-          (std::thread([patl]()
+          (std::thread([patl, i]()
           {
             if (patl)
               timeline = std::make_unique<TimeLine>();
           
-            TPToken ptoken(queue); 
-            TCToken ctoken(queue); 
+            // all slots taken by other threads: this worker stays idle
+            TaskDeque * pdq = myDeque();
+            if (!pdq) return;
+            TaskDeque & dq = *pdq;
+            thread_nr = i;
+            thread_slot[i] = my_slot.nr;
             
             while(true)
               {
                 if (stop) break;
 
-                Task task;
-                if(!queue.try_dequeue_from_producer(ptoken, task)) 
-                  if(!queue.try_dequeue(ctoken, task))  
-                    continue; 
-                
-                (*task.pfunc)(task.nr, task.size);
-                (*task.cnt)++;
+                size_t epoch = work_epoch;
+                Range r;
+                if (!findWork(dq, r))
+                  {
+                    backOff (epoch, true, [] { return false; });
+                    continue;
+                  }
+                execute (dq, r);
               }
             
             if (patl)
               patl -> addTimeLine(std::move(*timeline));
           }));
+        // thread 0 is the caller, we leave it where it is
+        if (cpus.size())
+          pinThread (threads.back(), cpus[i % cpus.size()]);
       }
+    pool_threads = num_threads;
   }
 
-  void StopWorkers()
+  static void stopPool()
   {
-    stop = true;
+    {
+      std::lock_guard<std::mutex> lock(sleep_mutex);
+      stop = true;
+      sleep_cv.notify_all();
+    }
     for (auto & t : threads)
       t.join();
     threads.clear();
+    pool_threads = 0;
   }
 
+  // joins the workers at program exit
+  static struct PoolCleanup
+  {
+    ~PoolCleanup()
+    {
+      std::lock_guard<std::mutex> lock(pool_mutex);
+      stopPool();
+    }
+  } pool_cleanup;
+
   
-  void RunParallel (int num,
-                    const std::function<void(int nr, int size)> & func)
+  TaskManager :: TaskManager (int _num_threads)
   {
-    TPToken ptoken(queue);
-    TCToken ctoken(queue);
+    std::lock_guard<std::mutex> lock(pool_mutex);
+    num_threads = (_num_threads > 0) ? clampThreads(_num_threads) : DefaultNumThreads();
+
+    // only the global pool is running, but with a different size
+    if (pool_threads && pool_users == 0 && pool_threads != num_threads)
+      stopPool();
     
-    std::atomic<int> cnt{0};
+    if (pool_threads)
+      num_threads = pool_threads;
+    else
+      startPool(num_threads);
+    pool_users++;
+  }
+
+  TaskManager :: ~TaskManager ()
+  {
+    std::lock_guard<std::mutex> lock(pool_mutex);
+    pool_users--;
+    if (pool_users == 0 && !default_pool)
+      stopPool();
+  }
+  
+
+  int NumThreads()
+  {
+    std::lock_guard<std::mutex> lock(pool_mutex);
+    return pool_threads ? int(pool_threads) : DefaultNumThreads();
+  }
+
+  void SetNumThreads (int num)
+  {
+    std::lock_guard<std::mutex> lock(pool_mutex);
+    requested_threads = num;
+    // restarted with the new size by the next RunParallel
+    if (pool_users == 0 && pool_threads)
+      {
+        stopPool();
+        default_pool = false;
+      }
+  }
+  
+  void StartWorkers(int num)
+  {
+    SetNumThreads(num+1);
+    std::lock_guard<std::mutex> lock(pool_mutex);
+    if (!pool_threads)
+      startPool(DefaultNumThreads());
+    default_pool = true;
+  }
+
+  void SetThreadPinning (Pinning policy)
+  {
+    std::lock_guard<std::mutex> lock(pool_mutex);
+    pinning_initialized = true;
+    pinning = policy;
+    threads_pinned = (policy != Pinning::None);
+    // restarted with the new placement by the next RunParallel
+    if (pool_users == 0 && pool_threads)
+      {
+        stopPool();
+        default_pool = false;
+      }
+  }
+
+  bool ThreadsPinned()
+  {
+    int pinned = threads_pinned.load(std::memory_order_relaxed);
+    if (pinned < 0)
+      {
+        std::lock_guard<std::mutex> lock(pool_mutex);
+        pinned = (DefaultPinning() != Pinning::None);
+        threads_pinned = pinned;
+      }
+    return pinned;
+  }
+
+  std::vector<int> ThreadCpus()
+  {
+    std::lock_guard<std::mutex> lock(pool_mutex);
+    std::vector<int> cpus;
+    if (DefaultPinning() != Pinning::None)
+      {
+        auto order = PinningOrder(pinning);
+        for (int i = 1; i < std::max(int(pool_threads), 1) && order.size(); i++)
+          cpus.push_back(order[i % order.size()]);
+      }
+    return cpus;
+  }
+
+  void SetSpinTime (int microseconds)
+  {
+    spin_time_us = std::max(0, microseconds);
+  }
+
+  WorkerStatistics GetWorkerStatistics()
+  {
+    return { stat_sleeps, stat_wakeups, 1e-9 * stat_spin_ns };
+  }
+
+  void ResetWorkerStatistics()
+  {
+    stat_sleeps = 0;
+    stat_wakeups = 0;
+    stat_spin_ns = 0;
+  }
+
+  void StopWorkers()
+  {
+    std::lock_guard<std::mutex> lock(pool_mutex);
+    default_pool = false;
+    if (pool_users == 0)
+      stopPool();
+  }
+
+  
+  static void ensurePool()
+  {
+    if (!pool_threads)
+      {
+        std::lock_guard<std::mutex> lock(pool_mutex);
+        if (!pool_threads)
+          {
+            startPool(DefaultNumThreads());
+            default_pool = true;
+          }
+      }
+  }
+
+  // run other pieces until job is finished
+  static void helpUntilDone (TaskDeque & dq, Job & job)
+  {
+    while (job.remaining > 0)
+      {
+        size_t epoch = work_epoch;
+        Range r;
+        if (findWork(dq, r))
+          execute (dq, r);
+        else
+          backOff (epoch, false, [&] { return job.remaining == 0; });
+      }
+  }
 
+  
+  void RunParallel (int num, FunctionRef<void(int nr, int size)> func)
+  {
+    ensurePool();
 
-    for (size_t i = 0; i < num; i++)
+    // nothing to share, or nobody to share with
+    if (num == 1 || pool_threads == 1)
       {
-        Task task;
-        task.nr = i;
-        task.size = num;
-        task.pfunc = &func;
-        task.cnt = &cnt;
-        queue.enqueue(ptoken, task);
+        for (int i = 0; i < num; i++)
+          func(i, num);
+        return;
+      }
+    
+    TaskDeque * dq = myDeque();
+    if (!dq)
+      {
+        for (int i = 0; i < num; i++)
+          func(i, num);
+        return;
       }
 
     /*
-    // faster with bulk enqueue (error with gcc-Release)
-    Task firsttask;
-    firsttask.nr = 0;
-    firsttask.size = num;
-    firsttask.pfunc=&func;
-    firsttask.cnt = &cnt;
-    queue.enqueue_bulk (ptoken, firsttask, num);    
+      Give every thread one piece right away, in one bulk push:
+      thieves take the last pieces from the top, we keep the first
+      and pop the next one from the bottom.
     */
-    
-    while (cnt < num)
+    Job job { func, num, {num} };
+    int nthreads = pool_threads;
+    int pieces = std::min(num, nthreads);
+    Range first { &job, 0, num };
+    if (pieces > 1)
+      {
+        // piece p to thread (thread_nr+p), the rest in one bulk push
+        Range ranges[MAX_BULK];
+        int nbulk = 0;
+        pieces = std::min(pieces, MAX_BULK+1);
+        for (int p = pieces-1; p >= 1; p--)
+          {
+            Range piece { &job, int(int64_t(num)*p/pieces), int(int64_t(num)*(p+1)/pieces) };
+            int target = (thread_nr+p) % nthreads;
+            int slot = (target > 0) ? int(thread_slot[target]) : -1;
+            if (slot < 0 || !inboxes[slot].put(piece))
+              ranges[nbulk++] = piece;
+          }
+        first.end = int(int64_t(num)/pieces);
+        int pushed = dq->pushBulk(ranges, nbulk);
+        // what did not fit runs here
+        for (int i = pushed; i < nbulk; i++)
+          execute (*dq, ranges[i]);
+        announceWork();
+      }
+    execute (*dq, first);
+    helpUntilDone (*dq, job);
+  }
+
+
+  int TaskGraph :: addTask (std::function<void()> func, const std::vector<int> & deps)
+  {
+    int nr = tasks.size();
+    for (int d : deps)
+      if (d < 0 || d >= nr)
+        throw std::runtime_error("TaskGraph: dependency on a task not yet added");
+    for (int d : deps)
+      successors[d].push_back(nr);
+    tasks.push_back(std::move(func));
+    successors.emplace_back();
+    num_deps.push_back(deps.size());
+    return nr;
+  }
+
+  /*
+    A graph is one Job, task i is the Range [i,i+1). Finishing a task
+    pushes its successors which got ready onto the deque of the
+    finishing thread, where it continues with the last one (depth first),
+    idle threads steal the others.
+  */
+  void TaskGraph :: wait()
+  {
+    int num = tasks.size();
+    std::unique_ptr<std::atomic<int>[]> pending(new std::atomic<int>[num]);
+    for (int i = 0; i < num; i++)
+      pending[i] = num_deps[i];
+
+    ensurePool();
+    TaskDeque * dq = myDeque();
+    if (pool_threads == 1 || !dq)
       {
-        Task task;
-        if(!queue.try_dequeue_from_producer(ptoken, task)) 
-          if(!queue.try_dequeue(ctoken, task))
-            continue; 
-        
-        (*task.pfunc)(task.nr, task.size);
-        (*task.cnt)++;
+        std::vector<int> ready;
+        for (int i = num-1; i >= 0; i--)
+          if (num_deps[i] == 0) ready.push_back(i);
+        while (ready.size())
+          {
+            int i = ready.back();
+            ready.pop_back();
+            tasks[i]();
+            for (int s : successors[i])
+              if (--pending[s] == 0) ready.push_back(s);
+          }
       }
+    else
+      {
+        Job * pjob = nullptr;
+        auto run = [&] (int i, int size)
+        {
+          tasks[i]();
+          TaskDeque * mydq = myDeque();
+          bool pushed = false;
+          for (int s : successors[i])
+            if (--pending[s] == 0)
+              {
+                if (mydq && mydq->push(Range{pjob, s, s+1}))
+                  pushed = true;
+                else if (mydq)
+                  execute (*mydq, Range{pjob, s, s+1});
+                else
+                  {
+                    // a thread without deque runs the successor itself
+                    pjob->func(s, pjob->size);
+                    pjob->remaining--;
+                  }
+              }
+          if (pushed) announceWork();
+        };
+        Job job { run, num, {num} };
+        pjob = &job;
+
+        // the initially ready tasks, smallest number at the bottom
+        std::vector<Range> ready;
+        for (int i = num-1; i >= 0; i--)
+          if (num_deps[i] == 0) ready.push_back(Range{&job, i, i+1});
+        int pushed = dq->pushBulk(ready.data(), ready.size());
+        announceWork();
+        for (size_t i = pushed; i < ready.size(); i++)
+          execute (*dq, ready[i]);
+        helpUntilDone (*dq, job);
+      }
+
+    tasks.clear();
+    successors.clear();
+    num_deps.clear();
   }
-}
\ No newline at end of file
+}
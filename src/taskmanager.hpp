@@ -2,19 +2,162 @@
 #define TASKMANAGER_H
 
 #include<functional>
+#include<cstddef>
+#include<vector>
+#include<memory>
+#include<type_traits>
+#include<algorithm>
 
 
 namespace ASC_HPC
 {
+
+  /*
+    Non-owning reference to a callable: an object pointer and a
+    trampoline, no allocation however large the captures are.
+    The callable has to outlive the FunctionRef.
+  */
+  template <typename TSIG> class FunctionRef;
+
+  template <typename R, typename ... ARGS>
+  class FunctionRef<R(ARGS...)>
+  {
+    void * obj;
+    R (*call)(void * obj, ARGS... args);
+  public:
+    template <typename F,
+              typename = std::enable_if_t<!std::is_same_v<std::decay_t<F>, FunctionRef>>>
+    FunctionRef (F && f)
+      : obj(const_cast<void*>(static_cast<const void*>(std::addressof(f)))),
+        call([] (void * obj, ARGS... args) -> R
+        {
+          return (*static_cast<std::remove_reference_t<F>*>(obj))(std::forward<ARGS>(args)...);
+        }) { }
+
+    R operator() (ARGS... args) const { return call(obj, std::forward<ARGS>(args)...); }
+  };
   
+
+  /*
+    Keeps the worker threads alive while the object lives.
+    The pool is shared: a TaskManager created while workers are
+    already running reuses them, the last one alive stops them.
+    num_threads counts the calling thread, 0 means the default
+    (ASC_NUM_THREADS, or all hardware threads).
+
+    If no TaskManager exists, the first RunParallel starts a
+    process-global default pool which lives until program exit.
+  */
+  class TaskManager
+  {
+    int num_threads;
+  public:
+    explicit TaskManager (int num_threads = 0);
+    ~TaskManager ();
+    TaskManager (const TaskManager &) = delete;
+    TaskManager & operator= (const TaskManager &) = delete;
+
+    int numThreads() const { return num_threads; }
+  };
+
+  // threads used by the default pool, including the calling thread
+  int NumThreads();
+  // restarts the default pool with num threads, 0 goes back to the default
+  void SetNumThreads (int num);
+
+  /*
+    Placement of the worker threads on the cpus: Compact fills one
+    socket after the other, Scatter alternates between the sockets.
+    Default is no pinning, or ASC_PIN_THREADS=compact|scatter.
+    Piece p of every parallel loop preferably runs on the same thread,
+    so memory first touched in a loop stays local to the thread which
+    works on it in later loops.
+  */
+  enum class Pinning { None, Compact, Scatter };
+  void SetThreadPinning (Pinning policy);
+  // cpus of the workers 1 ... NumThreads()-1, empty if not pinned
+  std::vector<int> ThreadCpus();
+
+  /*
+    The order in which threads are placed on the given cpus. Compact
+    fills one socket after the other, scatter alternates between sockets.
+    Both use all physical cores of all sockets before the hyper-threads.
+  */
+  struct CpuTopology { int cpu, socket, core; };
+  std::vector<int> PinningOrder (Pinning policy, const std::vector<CpuTopology> & cpus);
+
+  /*
+    Idle threads spin for the spin time, yield for the same time,
+    and then sleep until new work arrives. Default is 100 microseconds,
+    or ASC_SPIN_TIME.
+  */
+  void SetSpinTime (int microseconds);
+
+  struct WorkerStatistics
+  {
+    size_t sleeps;       // times a worker went to sleep
+    size_t wakeups;      // times a worker was woken up
+    double spin_time;    // seconds spent spinning and yielding, all threads
+  };
+  WorkerStatistics GetWorkerStatistics();
+  void ResetWorkerStatistics();
+
+  // old interface: default pool with num worker threads, and releasing it
   void StartWorkers(int num);
   void StopWorkers();
+
+  // calls func(nr, num) for nr = 0 ... num-1, may be nested
+  void RunParallel (int num, FunctionRef<void(int nr, int size)> func);
+
+
+  // true if the workers are pinned, cheap after the first call
+  bool ThreadsPinned();
+
+  /*
+    Zero the memory of a new array from all threads, such that its pages
+    are placed on the NUMA node of the thread which works on them in
+    parallel loops split the same way. Only with pinned threads, otherwise
+    the threads move between sockets anyway. Small arrays are left alone.
+  */
+  constexpr size_t FIRST_TOUCH_BYTES = size_t(1) << 22;
   
-  void RunParallel (int num,
-                    const std::function<void(int nr, int size)> & func);
-  
+  template <typename T>
+  void ParallelFirstTouch (T * data, size_t n)
+  {
+    if constexpr (std::is_trivially_default_constructible_v<T>)
+      if (n*sizeof(T) >= FIRST_TOUCH_BYTES && ThreadsPinned())
+        {
+          int num = NumThreads();
+          RunParallel (num, [data, n] (int nr, int size)
+          {
+            size_t first = n*nr/size, next = n*(nr+1)/size;
+            std::fill (data+first, data+next, T(0));
+          });
+        }
+  }
+
+
+  /*
+    Tasks with dependencies. A task may only depend on tasks added
+    before, so the graph has no cycles. wait() runs all tasks on the
+    worker pool, each as soon as its dependencies are finished, and
+    returns when all are done. Afterwards the graph is empty and can
+    be filled again.
+  */
+  class TaskGraph
+  {
+    std::vector<std::function<void()>> tasks;
+    std::vector<std::vector<int>> successors;
+    std::vector<int> num_deps;
+  public:
+    // returns the task number, for use in the deps of later tasks
+    int addTask (std::function<void()> func, const std::vector<int> & deps = {});
+    int size() const { return tasks.size(); }
+    void wait();
+  };
+
 }
 
 
 
-#endif
\ No newline at end of file
+#endif
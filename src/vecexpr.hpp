@@ -2,6 +2,17 @@
 #define FILE_EXPRESSION_VEC
 
 #include <cassert>
+#include <type_traits>
+
+#include "simd_functions.hpp"
+
+/*
+  Besides the entry v(i), expressions of contiguous float or double
+  vectors provide v.eval_simd<S>(i), the entries i ... i+S-1 as one
+  SIMD<T,S>, and v.contiguous(), which tells whether all vectors in
+  the expression have unit stride. Vector assignment uses them to
+  evaluate a whole expression register by register.
+*/
 
 namespace ASC_bla
 {
@@ -10,11 +21,46 @@ namespace ASC_bla
   class VecExpr
   {
   public:
-    auto derived() const { return static_cast<const T&> (*this); }
+    const T & derived() const { return static_cast<const T&> (*this); }
     size_t size() const { return derived().size(); }
     auto operator() (size_t i) const { return derived()(i); }
   };
   
+  /*
+    Operands of expression nodes: expressions and views are small and
+    held by value, types which own their entries (like Vec<N>) are held
+    by const reference, so building an expression never copies entries.
+    Such operands must outlive the expression, as temporaries do until
+    the end of the statement.
+  */
+  template <typename T>
+  constexpr bool hold_by_reference = false;
+
+  template <typename T>
+  using expr_operand_t = std::conditional_t<hold_by_reference<T>, const T &, T>;
+
+  template <typename TSCAL, typename TV> class ScaleVecExpr;
+
+  template <typename T>
+  constexpr bool is_scale_vec_expr = false;
+  template <typename TSCAL, typename TV>
+  constexpr bool is_scale_vec_expr<ScaleVecExpr<TSCAL,TV>> = true;
+
+  // a+b, as one FMA if a or b is scaled
+  template <size_t S, typename TA, typename TB>
+  auto fmaOrAdd (const TA & a, const TB & b, size_t i)
+  {
+    if constexpr (is_scale_vec_expr<TA>)
+      {
+        auto v = a.vector().template eval_simd<S>(i);
+        return FMA(decltype(v)(a.scalar()), v, b.template eval_simd<S>(i));
+      }
+    else if constexpr (is_scale_vec_expr<TB>)
+      return fmaOrAdd<S> (b, a, i);
+    else
+      return a.template eval_simd<S>(i) + b.template eval_simd<S>(i);
+  }
+
  // ***************** Sum of two vectors *****************
 
   template <typename TA, typename TB>
@@ -26,13 +72,17 @@ namespace ASC_bla
     SumVecExpr (TA _a, TB _b) : a(_a), b(_b) { }
     auto operator() (size_t i) const { return a(i)+b(i); }
     size_t size() const { return a.size(); }      
+
+    bool contiguous() const { return a.contiguous() && b.contiguous(); }
+    template <size_t S>
+    auto eval_simd (size_t i) const { return fmaOrAdd<S>(a, b, i); }
   };
   
   template <typename TA, typename TB>
   auto operator+ (const VecExpr<TA> & a, const VecExpr<TB> & b)
   {
     assert (a.size() == b.size());
-    return SumVecExpr(a.derived(), b.derived());
+    return SumVecExpr<expr_operand_t<TA>, expr_operand_t<TB>> (a.derived(), b.derived());
   }
 
 
@@ -45,32 +95,45 @@ namespace ASC_bla
     TV vec;
   public:
     ScaleVecExpr (TSCAL _scal, TV _vec) : scal(_scal), vec(_vec) { }
+    TSCAL scalar() const { return scal; }
+    const TV & vector() const { return vec; }
     auto operator() (size_t i) const { return scal*vec(i); }
     size_t size() const { return vec.size(); }      
+
+    bool contiguous() const { return vec.contiguous(); }
+    template <size_t S>
+    auto eval_simd (size_t i) const
+    {
+      auto v = vec.template eval_simd<S>(i);
+      return decltype(v)(scal) * v;
+    }
   };
   
   template <typename T>
   auto operator* (double scal, const VecExpr<T> & v)
   {
-    return ScaleVecExpr(scal, v.derived());
+    return ScaleVecExpr<double, expr_operand_t<T>> (scal, v.derived());
   }
 
-  // **************** dot product of two vectors *****************
- 
-  template <typename TA, typename TB>
-  auto dot (const VecExpr<TA> & a, const VecExpr<TB> & b)
-  {
-    assert (a.size() == b.size());
+  // ***************** SIMD evaluation *****************
 
-    using elemtypeA = typename std::invoke_result<TA,size_t>::type;
-    using elemtypeB = typename std::invoke_result<TB,size_t>::type;
-    using TSUM = decltype(std::declval<elemtypeA>()*std::declval<elemtypeB>());
+  // scalar type of an expression with eval_simd, void if it has none.
+  // Vector types specialize it (see vector.hpp)
+  template <typename T>
+  struct simd_scalar { typedef void type; };
+  template <typename T>
+  using simd_scalar_t = typename simd_scalar<T>::type;
+  template <typename T>
+  struct simd_scalar<const T &> : simd_scalar<T> { };
 
-    TSUM sum = 0;
-    for (size_t i = 0; i < a.size(); i++)
-      sum += a(i)*b(i);
-    return sum;
-  }
+  template <typename TA, typename TB>
+  struct simd_scalar<SumVecExpr<TA,TB>>
+  {
+    typedef std::conditional_t<std::is_same_v<simd_scalar_t<TA>, simd_scalar_t<TB>>,
+                               simd_scalar_t<TA>, void> type;
+  };
+  template <typename TSCAL, typename TV>
+  struct simd_scalar<ScaleVecExpr<TSCAL,TV>> { typedef simd_scalar_t<TV> type; };
 
   // ***************** Output operator *****************
 
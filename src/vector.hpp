@@ -2,12 +2,64 @@
 #define FILE_VECTOR
 
 #include <iostream>
+#include <memory>
+#include <cstdint>
+#include <algorithm>
 
 #include "vecexpr.hpp"
+#include "reduction.hpp"
+#include "allocator.hpp"
+#include "simd_functions.hpp"
+#include "taskmanager.hpp"
 
 
 namespace ASC_bla
 {
+
+  /*
+    Vectors from PARALLEL_VECTOR_SIZE entries are split over the ASC_HPC
+    workers: work(first, next) is called for pieces of data starting at
+    64 byte cache line boundaries (for contiguous vectors), so no two
+    workers write to the same line.
+  */
+  constexpr size_t PARALLEL_VECTOR_SIZE = size_t(1) << 15;
+
+  template <typename T, typename F>
+  void parallelPieces (const T * data, size_t n, F work)
+  {
+    if (n < PARALLEL_VECTOR_SIZE)
+      {
+        work (0, n);
+        return;
+      }
+    // entries per cache line, and the first entry starting a line
+    constexpr size_t line = std::max<size_t> (64/sizeof(T), 1);
+    size_t lead = ((64 - reinterpret_cast<uintptr_t>(data) % 64) % 64) / sizeof(T) % line;
+    auto boundary = [n, lead] (size_t i)
+    {
+      if (i <= lead) return size_t(0);
+      return std::min (lead + (i-lead) / line * line, n);
+    };
+    int pieces = std::min<size_t> (4*ASC_HPC::NumThreads(), n / (PARALLEL_VECTOR_SIZE/4));
+    ASC_HPC::RunParallel (pieces, [n, &work, &boundary] (int nr, int size)
+    {
+      size_t first = boundary (n*nr/size);
+      size_t next = (nr+1 == size) ? n : boundary (n*(nr+1)/size);
+      work (first, next);
+    });
+  }
+
+  // y(i) = e(i) for first <= i < next, SIMD_WIDTH entries at a time
+  template <typename T, typename TE>
+  void assignSIMD (T * y, const TE & e, size_t first, size_t next)
+  {
+    constexpr size_t SW = SIMD_WIDTH<T>;
+    size_t i = first;
+    for ( ; i+SW <= next; i += SW)
+      e.template eval_simd<SW>(i).store(y+i);
+    for ( ; i < next; i++)
+      y[i] = e(i);
+  }
  
   template <typename T, typename TDIST = std::integral_constant<size_t,1> >
   class VectorView : public VecExpr<VectorView<T,TDIST>>
@@ -22,7 +74,7 @@ namespace ASC_bla
     
     template <typename TDIST2>
     VectorView (const VectorView<T,TDIST2> & v2)
-      : m_data(v2.data()), m_size(v2.Size()), m_dist(v2.dist()) { }
+      : m_data(v2.data()), m_size(v2.size()), m_dist(v2.dist()) { }
     
     VectorView (size_t size, T * data)
       : m_data(data), m_size(size) { }
@@ -30,12 +82,27 @@ namespace ASC_bla
     VectorView (size_t size, TDIST dist, T * data)
       : m_data(data), m_size(size), m_dist(dist) { }
     
+    // entries are computed and stored at the same index, so the
+    // vector may appear in the expression, but not shifted
     template <typename TB>
     VectorView & operator= (const VecExpr<TB> & v2)
     {
       assert (m_size == v2.size());
-      for (size_t i = 0; i < m_size; i++)
-        m_data[m_dist*i] = v2(i);
+      const TB & expr = static_cast<const TB&>(v2);
+      if constexpr (std::is_same_v<simd_scalar_t<TB>, T>)
+        if (m_dist == 1 && expr.contiguous())
+          {
+            parallelPieces (m_data, m_size, [this, &expr] (size_t first, size_t next)
+            {
+              assignSIMD (m_data, expr, first, next);
+            });
+            return *this;
+          }
+      parallelPieces (m_data, m_size, [this, &expr] (size_t first, size_t next)
+      {
+        for (size_t i = first; i < next; i++)
+          m_data[m_dist*i] = expr(i);
+      });
       return *this;
     }
 
@@ -52,6 +119,10 @@ namespace ASC_bla
     
     T & operator()(size_t i) { return m_data[m_dist*i]; }
     const T & operator()(size_t i) const { return m_data[m_dist*i]; }
+
+    bool contiguous() const { return m_dist == 1; }
+    template <size_t S>
+    SIMD<T,S> eval_simd (size_t i) const { return SIMD<T,S>(m_data+i); }
     
     auto range(size_t first, size_t next) const {
       assert(first <= next && next <= m_size);
@@ -67,15 +138,27 @@ namespace ASC_bla
   
 
   
-  template <typename T>
+  // ALLOC is a stateless allocator, by default aligned memory from the pool
+  template <typename T, typename ALLOC = PoolAllocator<T>>
   class Vector : public VectorView<T>
   {
     typedef VectorView<T> BASE;
     using BASE::m_size;
     using BASE::m_data;
+
+    // the expression constructor writes all entries right away, in parallel
+    struct NoFirstTouch { };
+    Vector (size_t size, NoFirstTouch)
+      : VectorView<T> (size, ALLOC().allocate(size))
+    {
+      std::uninitialized_default_construct_n (m_data, size);
+    }
   public:
     Vector (size_t size) 
-      : VectorView<T> (size, new T[size]) { ; }
+      : Vector (size, NoFirstTouch())
+    {
+      ASC_HPC::ParallelFirstTouch (m_data, size);
+    }
     
     Vector (const Vector & v)
       : Vector(v.size())
@@ -92,12 +175,17 @@ namespace ASC_bla
 
     template <typename TB>
     Vector (const VecExpr<TB> & v)
-      : Vector(v.size())
+      : Vector(v.size(), NoFirstTouch())
     {
       *this = v;
     }
     
-    ~Vector () { delete [] m_data; }
+    ~Vector ()
+    {
+      if (!m_data) return;
+      std::destroy_n (m_data, m_size);
+      ALLOC().deallocate (m_data, m_size);
+    }
 
     using BASE::operator=;
     Vector & operator=(const Vector & v2)
@@ -117,6 +205,71 @@ namespace ASC_bla
   };
 
 
+  template <typename T, typename TDIST>
+  struct simd_scalar<VectorView<T,TDIST>>
+  {
+    typedef std::conditional_t<std::is_same_v<T,double> || std::is_same_v<T,float>, T, void> type;
+  };
+
+
+  /*
+    y = coefs[0]*x[0] + ... + coefs[num-1]*x[num-1] in one pass over
+    memory, for expressions built at run time (e.g. from Python).
+    Every chunk of y is computed from all terms before it is stored, so
+    y may be one of the x, but not a shifted window of one.
+    Long vectors are split over the ASC_HPC workers.
+  */
+  template <typename T, typename TDIST>
+  void LinearCombination (VectorView<T,TDIST> y, size_t num, const T * coefs,
+                          const VectorView<T,size_t> * x)
+  {
+    size_t n = y.size();
+    if (n == 0) return;
+
+    bool unit_stride = y.dist() == 1;
+    for (size_t t = 0; t < num; t++)
+      unit_stride = unit_stride && x[t].dist() == 1;
+
+    auto work = [=] (size_t first, size_t next)
+    {
+      if constexpr (std::is_same_v<T,double> || std::is_same_v<T,float>)
+        if (unit_stride)
+          {
+            constexpr size_t SW = SIMD_WIDTH<T>;
+            T * py = y.data();
+            size_t i = first;
+            for ( ; i+SW <= next; i += SW)
+              {
+                SIMD<T,SW> sum(T(0));
+                for (size_t t = 0; t < num; t++)
+                  sum = FMA(SIMD<T,SW>(coefs[t]), SIMD<T,SW>(x[t].data()+i), sum);
+                sum.store(py+i);
+              }
+            if (i < next)
+              {
+                auto mask = SIMD<simd_mask_t<T>,SW>::mask_first(next-i);
+                SIMD<T,SW> sum(T(0));
+                for (size_t t = 0; t < num; t++)
+                  sum = FMA(SIMD<T,SW>(coefs[t]), SIMD<T,SW>(x[t].data()+i, mask), sum);
+                sum.store(py+i, mask);
+              }
+            return;
+          }
+      
+      T * py = y.data();
+      for (size_t i = first; i < next; i++)
+        {
+          T sum(0);
+          for (size_t t = 0; t < num; t++)
+            sum += coefs[t] * x[t](i);
+          py[y.dist()*i] = sum;
+        }
+    };
+
+    parallelPieces (y.data(), n, work);
+  }
+
+
   template <typename ...Args>
   std::ostream & operator<< (std::ostream & ost, const VectorView<Args...> & v)
   {